@@ -158,7 +158,7 @@ LOWERCODESIZE void adsr_setCVs(struct adsr_s * adsr, uint16_t atk, uint16_t dec,
 void adsr_setGate(struct adsr_s * a, int8_t gate)
 {
 	a->phase=0;
-	a->stageLevel=((uint32_t)a->output<<16)/a->levelCV;
+	a->stageLevel=a->levelCV?((uint32_t)a->output<<16)/a->levelCV:0; // levelCV is still 0 before the first velocity is set
 
 	if(gate)
 	{
@@ -6,7 +6,7 @@
 
 #include "storage.h"
 
-struct
+static struct
 {
 	uint16_t counter,speed;
 } clock;
@@ -17,7 +17,7 @@ inline void clock_setSpeed(uint16_t speed)
 	if(speed<1024)
 		clock.speed=UINT16_MAX;
 	else if(settings.syncMode==smInternal)
-		clock.speed=exponentialCourse(speed,22000.0f,500.0f);
+		clock.speed=exponentialCourse(speed,EXP_COEF(22000),500);
 	else
         clock.speed=extClockDividers[(((uint32_t)speed)*16)>>16];
 }
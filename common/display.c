@@ -56,6 +56,14 @@ void LOWERCODESIZE sevenSeg_setNumber(int32_t n)
 	sevenSeg_setAscii('0'+(n/10),'0'+(n%10));
 }
 
+void LOWERCODESIZE sevenSeg_setPresetNumber(uint16_t n, int8_t tensOnly)
+{
+	// none of these letters look like a digit on 7 segments
+	static const PROGMEM char hundredTens[]="AbcdEFGhij";
+
+	sevenSeg_setAscii((n<100)?'0'+(n/10):pgm_read_byte(&hundredTens[(n/10-10)%10]),tensOnly?' ':'0'+(n%10));
+}
+
 void sevenSeg_setRelative(comparator_t comparator)
 {
     display_clear();
@@ -14,6 +14,7 @@ typedef enum
 void sevenSeg_scrollText(const char * text, int8_t times); // -1 -> infinite / 0 -> off
 void sevenSeg_setAscii(char left, char right);
 void sevenSeg_setNumber(int32_t n);
+void sevenSeg_setPresetNumber(uint16_t n, int8_t tensOnly); // from 100 on, letters are the tens: A0 is 100, j9 is 199
 void sevenSeg_setRelative(comparator_t comparator);
 
 int led_getOn(p600LED_t led);
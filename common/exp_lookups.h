@@ -0,0 +1,27 @@
+#ifndef EXP_LOOKUPS_H
+#define	EXP_LOOKUPS_H
+
+#include "synth.h"
+
+// (2^(i/256)-1)*65536, rounded, for i in [0,255]
+const PROGMEM uint16_t exp2Lookup[256]=
+{
+	0,178,356,535,714,893,1073,1254,1435,1617,1799,1981,2164,2348,2532,2716,
+	2902,3087,3273,3460,3647,3834,4022,4211,4400,4590,4780,4971,5162,5353,5546,5738,
+	5932,6125,6320,6514,6710,6906,7102,7299,7496,7694,7893,8092,8292,8492,8693,8894,
+	9096,9298,9501,9704,9908,10113,10318,10524,10730,10937,11144,11352,11560,11769,11979,12189,
+	12400,12611,12823,13036,13249,13462,13676,13891,14106,14322,14539,14756,14974,15192,15411,15630,
+	15850,16071,16292,16514,16737,16960,17183,17408,17633,17858,18084,18311,18538,18766,18995,19224,
+	19454,19684,19915,20147,20379,20612,20846,21080,21315,21550,21786,22023,22260,22498,22737,22977,
+	23216,23457,23698,23940,24183,24426,24670,24915,25160,25406,25652,25900,26148,26396,26645,26895,
+	27146,27397,27649,27902,28155,28409,28664,28919,29175,29432,29690,29948,30207,30466,30727,30988,
+	31249,31512,31775,32039,32303,32568,32834,33101,33369,33637,33906,34175,34446,34717,34988,35261,
+	35534,35808,36083,36359,36635,36912,37190,37468,37747,38028,38308,38590,38872,39155,39439,39724,
+	40009,40295,40582,40870,41158,41448,41738,42029,42320,42613,42906,43200,43495,43790,44087,44384,
+	44682,44981,45280,45581,45882,46184,46487,46791,47095,47401,47707,48014,48322,48631,48940,49251,
+	49562,49874,50187,50500,50815,51131,51447,51764,52082,52401,52721,53041,53363,53685,54008,54333,
+	54658,54983,55310,55638,55966,56296,56626,56957,57289,57622,57956,58291,58627,58964,59301,59640,
+	59979,60319,60661,61003,61346,61690,62035,62381,62727,63075,63424,63774,64124,64476,64828,65182
+};
+
+#endif	/* EXP_LOOKUPS_H */
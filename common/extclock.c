@@ -0,0 +1,132 @@
+////////////////////////////////////////////////////////////////////////////////
+// External clock recovery: tracks the master's 24ppq MIDI clock with a PLL
+////////////////////////////////////////////////////////////////////////////////
+
+// The phase accumulator counts clocks (8.24 fixed point) and advances by the
+// estimated tempo on each timer tick. Each incoming clock corrects its phase
+// and tempo, clock steps are taken when it crosses an integer.
+// The phase is aimed a little after the clock, so that steps keep a steady
+// pace through the master's jitter, but they are never taken ahead of it: a
+// very late clock is stepped on arrival.
+
+#include "extclock.h"
+
+#define EXTCLOCK_FRAC 24
+#define EXTCLOCK_ONE ((uint32_t)1<<EXTCLOCK_FRAC)
+
+#define EXTCLOCK_PHASE_GAIN 2 // phase correction: 1/4 of the error
+#define EXTCLOCK_TEMPO_GAIN 5 // tempo correction: 1/32 of the error, relative
+#define EXTCLOCK_RELOCK_ERROR (EXTCLOCK_ONE/2) // clocks
+#define EXTCLOCK_LOST_CLOCKS 2 // without an incoming clock, the master stopped
+#define EXTCLOCK_LAG_TICKS 2 // steps are aimed that late after the clock, to smooth out its jitter
+
+#define TIMER_TICKS_PER_MINUTE (2000L*60L) // synth_timerInterrupt() is 2Khz
+
+typedef enum {esIdle=0,esFirst=1,esLocked=2} extclockState_t;
+
+static struct
+{
+	uint32_t phase; // clocks at timer tick phaseTick
+	uint32_t inc; // clocks per timer tick
+	uint16_t phaseTick,lastStamp;
+	uint8_t received,stepped;
+	extclockState_t state;
+} extclock;
+
+static inline int32_t roundShift(int32_t v, int8_t shift)
+{
+	return (v+((int32_t)1<<(shift-1)))>>shift;
+}
+
+void extclock_reset(void)
+{
+	extclock.phase=0;
+	extclock.received=0;
+	extclock.stepped=0;
+	extclock.state=esIdle;
+}
+
+// stamp: timer tick at which the clock was received
+void extclock_pulse(uint16_t stamp)
+{
+	uint16_t interval;
+	int16_t age;
+	int32_t error;
+
+	++extclock.received;
+
+	age=(int16_t)(stamp+EXTCLOCK_LAG_TICKS-extclock.phaseTick);
+
+	if(extclock.state==esLocked)
+	{
+		// error between the clock count and the phase we predicted at arrival time
+
+		error=(((uint32_t)extclock.received)<<EXTCLOCK_FRAC)-(extclock.phase+extclock.inc*age);
+
+		if(error>=-(int32_t)EXTCLOCK_RELOCK_ERROR && error<=(int32_t)EXTCLOCK_RELOCK_ERROR)
+		{
+			extclock.phase+=roundShift(error,EXTCLOCK_PHASE_GAIN);
+			extclock.inc+=roundShift(roundShift(error,8)*roundShift(extclock.inc,8),8+EXTCLOCK_TEMPO_GAIN);
+			extclock.lastStamp=stamp;
+			return;
+		}
+	}
+
+	// (re)start tracking from the last interval
+
+	if(extclock.state!=esIdle)
+	{
+		interval=stamp-extclock.lastStamp;
+		if(!interval)
+			interval=1;
+		extclock.inc=EXTCLOCK_ONE/interval;
+		extclock.phase=(((uint32_t)extclock.received)<<EXTCLOCK_FRAC)-extclock.inc*age;
+		extclock.state=esLocked;
+	}
+	else
+	{
+		extclock.state=esFirst;
+	}
+
+	extclock.lastStamp=stamp;
+}
+
+// now: current timer tick, returns how many clock steps to take
+uint8_t extclock_update(uint16_t now)
+{
+	uint8_t target,steps;
+
+	target=extclock.received;
+
+	if(extclock.state==esLocked)
+	{
+		extclock.phase+=extclock.inc*(uint16_t)(now-extclock.phaseTick);
+
+		if((int8_t)((extclock.phase>>EXTCLOCK_FRAC)-extclock.received)>=EXTCLOCK_LOST_CLOCKS)
+		{
+			// start over on the next clock
+			extclock.state=esIdle;
+		}
+		else if((int8_t)((extclock.phase>>EXTCLOCK_FRAC)-extclock.received)<0)
+		{
+			target=extclock.phase>>EXTCLOCK_FRAC;
+		}
+	}
+
+	extclock.phaseTick=now;
+
+	steps=target-extclock.stepped;
+	if((int8_t)steps<0) // phase correction went backwards
+		return 0;
+
+	extclock.stepped=target;
+	return steps;
+}
+
+uint16_t extclock_getBPM(void)
+{
+	if(extclock.state!=esLocked)
+		return 0;
+
+	return (((extclock.inc>>8)*(TIMER_TICKS_PER_MINUTE/24))+((uint32_t)1<<15))>>16;
+}
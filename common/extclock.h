@@ -0,0 +1,11 @@
+#ifndef EXTCLOCK_H
+#define EXTCLOCK_H
+
+#include <stdint.h>
+
+void extclock_reset(void);
+void extclock_pulse(uint16_t stamp);
+uint8_t extclock_update(uint16_t now);
+uint16_t extclock_getBPM(void);
+
+#endif /* EXTCLOCK_H */
@@ -7,7 +7,7 @@
 // Low level interface, implemented by firmware or mockup
 ////////////////////////////////////////////////////////////////////////////////
 
-#include "hardware_impl.h" // should implement CYCLE_WAIT(cycles) , BLOCK_INT{} , MDELAY(ms)
+#include "hardware_impl.h" // should implement CYCLE_WAIT(cycles) , BLOCK_INT{} , MDELAY(ms) , CYCLE_COUNT() , CYCLE_COUNT_PER_TICK
 
 extern void mem_write(uint16_t address, uint8_t value);
 extern void io_write(uint8_t address, uint8_t value);
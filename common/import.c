@@ -11,7 +11,7 @@ const uint8_t z80EnvCV[16]=
 	0,55,86,101,111,124,135,139,143,148,154,164,176,185,191,210
 };
 
-__attribute__((packed)) struct z80Patch_t
+struct __attribute__((packed)) z80Patch_t // 16 bytes, the attribute is ignored before "struct"
 {
 	// pots
 	uint16_t pwA : 7;
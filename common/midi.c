@@ -9,32 +9,196 @@
 #include "uart_6850.h"
 #include "import.h"
 #include "arp.h"
+#include "profiler.h"
+#include "display.h"
 
 #include "../xnormidi/midi_device.h"
 #include "../xnormidi/midi.h"
-#include "../xnormidi/bytequeue/bytequeue.h"
+#include "../xnormidi/bytequeue/spscqueue.h"
 
-#define MAX_SYSEX_SIZE TEMP_BUFFER_SIZE
+void midi_process_byte(MidiDevice * device, uint8_t input); // [implementation in midi_device.c]
 
 #define MIDI_BASE_STEPPED_CC 48
 #define MIDI_BASE_COARSE_CC 16
 #define MIDI_BASE_FINE_CC 80
 
+// NRPN controllers, 98, 99 & 38 are also the fine cpPModFilEnv & cpPModOscB CCs and the coarse cpGlide one:
+// they only are NRPN ones in a sequence, 99 right followed by 98, then 6 and 38 right after it
+#define MIDI_DATA_ENTRY_MSB 6
+#define MIDI_DATA_ENTRY_LSB 38
+#define MIDI_NRPN_LSB 98
+#define MIDI_NRPN_MSB 99
+
+#define NRPN_CONTINUOUS_MSB 0 // NRPN 0/n: continuousParameters[n], 14 bits
+#define NRPN_STEPPED_MSB 1 // NRPN 1/n: steppedParameters[n], data entry msb like its stepped CC
+#define NRPN_LSB_TIMEOUT_TICKS 2 // a data entry msb waits that long for its lsb, a CC 99 for a CC 98
+
+#define SEND_QUEUE_SIZE 256 // power of 2, ~80ms at wire rate, room for a whole preset dump sysex, bytes are sent from the UART interrupt (INT4, see uart_setTxInterrupt)
+
+#define RUNNING_STATUS_REFRESH_TICKS 250 // resend the status byte at least every 500ms, for receivers that joined late
+
+#define PROGRAM_BANK_SIZE 100 // bank select (CC 0) 2 moves program changes to presets 100 and up, 1 keeps them at 0 to 127
+
+#define DUMP_SEND_RESERVE 16 // send queue bytes a bulk dump leaves to other messages
+#define DUMP_SYSEX_SIZE(size) (5+((size)+3)/4*5+1) // sysex bytes for an export of that size (header, groups, F7)
+
+#define PANEL_QUEUE_LIMIT 32 // panel moves wait while more than that is queued
+#define PANEL_BYTES_PER_TICK 1 // ~500 bytes/s, a sixth of the wire rate
+#define PANEL_BURST_BYTES 24
+
+typedef enum
+{
+	nsIdle=0,
+	nsSelected,
+	nsDataMsb // got CC 6, waiting for CC 38
+} nrpnState_t;
+
+typedef enum
+{
+	ssIdle=0, // not in a sysex, or rejected
+	ssHeader, // buffering the header until we know what it is
+	ssBuffer, // buffering the whole message in tempBuffer (requests, SCI dumps, MTS)
+	ssPatchDump // decoding into tempBuffer as it comes, the header is done with
+} sysexState_t;
+
 static MidiDevice midi;
-static int16_t sysexSize;
-static byteQueue_t sendQueue;
-static uint8_t sendQueueData[32];
+static struct
+{
+	sysexState_t state;
+	uint16_t count; // bytes of the current message, as counted by xnormidi
+	int16_t size; // buffered bytes, or decoded bytes for ssPatchDump
+	uint8_t group[5],groupSize; // 4 data bytes, then their high bits
+	uint8_t number;
+} sysex;
+static struct
+{
+	nrpnState_t state;
+	uint8_t numberMsb,numberLsb;
+	uint8_t dataMsb;
+	uint32_t dataTick;
+	int8_t msbPending; // got CC 99, a CC 98 right after it makes it a parameter number, anything else a fine CC
+	uint8_t pendingMsb;
+	uint32_t msbTick;
+} nrpn;
+static struct
+{
+	uint16_t last[cpCount]; // last value sent
+	uint8_t pending[(cpCount+7)/8]; // bit per parameter
+	uint8_t next; // round robin
+	uint8_t budget; // bytes
+	uint32_t budgetTick;
+	uint8_t nrpnMsb,nrpnLsb; // last NRPN sent, nrpnMsb 0xff: none
+	uint32_t nrpnTick;
+} panel;
+static spscQueue_t sendQueue; // written under BLOCK_INT, read by the UART interrupt
+static uint8_t sendQueueData[SEND_QUEUE_SIZE];
+static uint8_t sendHighWater;
+static uint16_t sendOverflows;
+#ifdef MIDI_RUNNING_STATUS
+static uint8_t sendRunningStatus; // 0: none
+static uint32_t sendRunningStatusTick;
+#endif
+
+// the preset bank program changes are in: 0, or 1 for PROGRAM_BANK_SIZE on (bank select value-1)
+static struct
+{
+	uint8_t receive,send;
+} programBank;
+
+static struct
+{
+	int16_t number; // next preset to dump, -1: none
+} dump;
+
+// messages whose handler uses the storage wait while the main loop does (see storage_isBusy()),
+// the rest of the input waits behind them
+static struct
+{
+	int8_t sysexEnd; // sysexEnd() is due
+	int8_t presetMode; // CC 0 switches to it, -1: none
+} storageWait;
 
 extern void refreshFullState(void);
 extern void refreshPresetMode(void);
 
+static int8_t setContinuousBits(uint16_t * p, uint16_t value, uint16_t mask);
+static uint8_t setContinuous(int16_t param, uint16_t value, uint16_t mask);
+static uint8_t setStepped(int16_t param, uint8_t v);
+static void parameterChanged(uint8_t change);
+
+// polled transmit of the oldest queued byte, for when the UART interrupt can't drain the queue for us
+// (it would be a second reader, so the interrupt is kept out meanwhile)
+static void sendFlushOne(void)
+{
+	int8_t done=0;
+
+	while(!done)
+	{
+		BLOCK_INT
+		{
+			if(!spscqueue_length(&sendQueue))
+			{
+				done=1;
+			}
+			else if(uart_trySend(spscqueue_get(&sendQueue,0)))
+			{
+				spscqueue_remove(&sendQueue,1);
+				done=1;
+			}
+		}
+	}
+}
+
 static void sendEnqueue(uint8_t b)
 {
-	for(;;)
+	uint8_t len;
+
+	if(!spscqueue_enqueue(&sendQueue,b))
 	{
-		if(bytequeue_enqueue(&sendQueue,b))
-			break;
-		midi_update(1);
+		// full, we might be in BLOCK_INT (sysex) or in the UART interrupt itself, so wait for the UART ourselves
+
+		++sendOverflows;
+
+		do
+			sendFlushOne();
+		while(!spscqueue_enqueue(&sendQueue,b));
+	}
+
+	len=spscqueue_length(&sendQueue);
+	if(len>sendHighWater)
+		sendHighWater=len;
+
+	uart_setTxInterrupt(1);
+}
+
+int8_t midi_nextSendByte(uint8_t * b)
+{
+	// the queue is safe to read while it's written, this only runs from the UART interrupt
+
+	if(!spscqueue_length(&sendQueue))
+		return 0;
+
+	*b=spscqueue_get(&sendQueue,0);
+	spscqueue_remove(&sendQueue,1);
+
+	return 1;
+}
+
+void midi_getSendStats(uint8_t * highWater, uint16_t * overflows)
+{
+	BLOCK_INT
+	{
+		*highWater=sendHighWater;
+		*overflows=sendOverflows;
+	}
+}
+
+void midi_resetSendStats(void)
+{
+	BLOCK_INT
+	{
+		sendHighWater=0;
+		sendOverflows=0;
 	}
 }
 
@@ -47,59 +211,46 @@ uint16_t midiCombineBytes(uint8_t first, uint8_t second)
    return _14bit;
 }
 
-static void sysexSend(uint8_t command, int16_t size)
+static void sysexSendHeader(uint8_t command)
 {
-	int16_t chunkCount,i;
-	uint8_t chunk[4];
-	
-	BLOCK_INT
-	{
-		chunkCount=((size-1)>>2)+1;
-
-		sendEnqueue(0xf0);
-		sendEnqueue(SYSEX_ID_0);
-		sendEnqueue(SYSEX_ID_1);
-		sendEnqueue(SYSEX_ID_2);
-		sendEnqueue(command);
+#ifdef MIDI_RUNNING_STATUS
+	sendRunningStatus=0;
+#endif
+	sendEnqueue(0xf0);
+	sendEnqueue(SYSEX_ID_0);
+	sendEnqueue(SYSEX_ID_1);
+	sendEnqueue(SYSEX_ID_2);
+	sendEnqueue(command);
+}
 
-		for(i=0;i<chunkCount;++i)
-		{
-			memcpy(chunk,&tempBuffer[i<<2],4);
+// 4 data bytes, then their high bits, remaining: bytes left in data
+static void sysexSendGroup(const uint8_t * data, int16_t remaining)
+{
+	uint8_t chunk[4];
 
-			sendEnqueue(chunk[0]&0x7f);
-			sendEnqueue(chunk[1]&0x7f);
-			sendEnqueue(chunk[2]&0x7f);
-			sendEnqueue(chunk[3]&0x7f);
-			sendEnqueue(((chunk[0]>>7)&1) | ((chunk[1]>>6)&2) | ((chunk[2]>>5)&4) | ((chunk[3]>>4)&8));
-		}
+	memset(chunk,0,4); // zero padding after the last byte
+	memcpy(chunk,data,MIN(4,remaining));
 
-		sendEnqueue(0xf7);
-	}
+	sendEnqueue(chunk[0]&0x7f);
+	sendEnqueue(chunk[1]&0x7f);
+	sendEnqueue(chunk[2]&0x7f);
+	sendEnqueue(chunk[3]&0x7f);
+	sendEnqueue(((chunk[0]>>7)&1) | ((chunk[1]>>6)&2) | ((chunk[2]>>5)&4) | ((chunk[3]>>4)&8));
 }
 
-static int16_t sysexDescrambleBuffer(int16_t start)
+static void sysexSend(uint8_t command, int16_t size)
 {
-	int16_t chunkCount,i,out;
-	uint8_t b;
+	int16_t i;
 	
-	chunkCount=((sysexSize-start)/5)+1;
-	out=start;
-
-	for(i=0;i<chunkCount;++i)
-	{
-		memmove(&tempBuffer[out],&tempBuffer[i*5+start],4);
-		
-		b=tempBuffer[i*5+start+4];
-		
-		tempBuffer[out+0]|=(b&1)<<7;
-		tempBuffer[out+1]|=(b&2)<<6;
-		tempBuffer[out+2]|=(b&4)<<5;
-		tempBuffer[out+3]|=(b&8)<<4;
-		
-		out+=4;
+	BLOCK_INT
+	{
+		sysexSendHeader(command);
+
+		for(i=0;i<size;i+=4)
+			sysexSendGroup(&tempBuffer[i],size-i);
+
+		sendEnqueue(0xf7);
 	}
-	
-	return out-start;
 }
 
 typedef struct {
@@ -149,71 +300,230 @@ static void mtsReceiveBulkTuningDump(uint8_t * buf, int16_t size) // imogen: thi
 
 }
 
-static void sysexReceiveByte(uint8_t b)
+static void sysexReject(void)
 {
-	int16_t size;
+#ifdef DEBUG
+	print("Warning: sysex rejected\n");
+#endif
+	sysex.state=ssIdle;
+}
 
-	switch(b)
+// once the header is known, decide what to do with the rest of the message
+static void sysexClassify(void)
+{
+	if(tempBuffer[0]==0x01) // SCI P600 program dump
 	{
-	case 0xF0: // Begin SysEx message
-		sysexSize=0;
-		memset(tempBuffer,0,MAX_SYSEX_SIZE);
-		break;
-	case 0xF7: // End SysEx message
-		if(tempBuffer[0]==0x01 && tempBuffer[1]==0x02) // SCI P600 program dump
+		if(!ui.isInPatchManagement || (sysex.size>1 && tempBuffer[1]!=0x02))
+			sysexReject();
+		else if(sysex.size>1)
+			sysex.state=ssBuffer;
+	}
+	else if(tempBuffer[0]==SYSEX_ID_0) // my sysex ID
+	{
+		if((sysex.size>1 && tempBuffer[1]!=SYSEX_ID_1) || (sysex.size>2 && tempBuffer[2]!=SYSEX_ID_2))
 		{
-			if (ui.isInPatchManagement)
-			{
-				import_sysex(tempBuffer,sysexSize);
-			}
+			sysexReject();
 		}
-		else if(tempBuffer[0]==SYSEX_ID_0 && tempBuffer[1]==SYSEX_ID_1 && tempBuffer[2]==SYSEX_ID_2) // my sysex ID
+		else if(sysex.size>3)
 		{
-			// handle my sysex commands
-			
 			switch(tempBuffer[3])
 			{
 			case SYSEX_COMMAND_PATCH_DUMP:
-				size=sysexDescrambleBuffer(4);
-				storage_import(tempBuffer[4],&tempBuffer[5],size-1);
+				sysex.size=0;
+				sysex.groupSize=0;
+				sysex.state=ssPatchDump;
 				break;
 			case SYSEX_COMMAND_PATCH_DUMP_REQUEST:
-				midi_dumpPreset(tempBuffer[4]);
+			case SYSEX_COMMAND_PROFILER_REQUEST:
+			case SYSEX_COMMAND_PARAMETER_SNAPSHOT:
+				sysex.state=ssBuffer;
 				break;
+			default:
+				sysexReject();
 			}
 		}
-		else if(tempBuffer[0]==SYSEX_ID_UNIVERSAL_NON_REALTIME) // imogen: if SysEx tuning data usage is removed (see above), this part will be obsolete as well  
+	}
+	else if(tempBuffer[0]==SYSEX_ID_UNIVERSAL_NON_REALTIME) // imogen: if SysEx tuning data usage is removed (see above), this part will be obsolete as well
+	{
+		if((sysex.size>2 && tempBuffer[2]!=SYSEX_SUBID1_BULK_TUNING_DUMP) || (sysex.size>3 && tempBuffer[3]!=SYSEX_SUBID2_BULK_TUNING_DUMP))
+			sysexReject(); // TODO: send a sysex MTS with our current tuning on SYSEX_SUBID2_BULK_TUNING_DUMP_REQUEST
+		else if(sysex.size>3)
+			sysex.state=ssBuffer;
+	}
+	else
+	{
+		sysexReject();
+	}
+}
+
+// patch dumps are sent in groups of 4 data bytes followed by their high bits
+// the first decoded byte is the patch number, the others are a storage page
+static void sysexDecodeGroup(void)
+{
+	uint8_t i,b;
+
+	for(i=0;i<4 && i<sysex.groupSize;++i)
+	{
+		b=sysex.group[i]|(((sysex.group[4]>>i)&1)<<7);
+
+		if(sysex.size==0)
+			sysex.number=b;
+		else if(sysex.size<=STORAGE_PAGE_SIZE)
+			tempBuffer[sysex.size-1]=b;
+
+		++sysex.size;
+	}
+
+	sysex.groupSize=0;
+}
+
+// many parameters set by one message, and refreshed once
+static void sysexSnapshot(uint8_t * buf, int16_t size)
+{
+	int16_t i,n=0;
+	uint8_t j,hi,id,count,change=0;
+
+	// 4+1 groups, decoded in place
+
+	for(i=0;i+5<=size;i+=5)
+	{
+		hi=buf[i+4];
+		for(j=0;j<4;++j)
+			buf[n++]=buf[i+j]|(((hi>>j)&1)<<7);
+	}
+
+	if(!n || !settings.presetMode)
+		return;
+
+	count=buf[0];
+	i=1;
+
+	while(count--)
+	{
+		id=buf[i];
+
+		if(id&0x80)
+		{
+			id&=0x7f;
+			if(id>=spCount || i+2>n)
+				break;
+
+			change|=setStepped(id,buf[i+1]);
+			i+=2;
+		}
+		else
 		{
-			switch(tempBuffer[2])
-			{
-			case SYSEX_SUBID1_BULK_TUNING_DUMP:			
-				switch(tempBuffer[3])
-				{
-					case SYSEX_SUBID2_BULK_TUNING_DUMP:
-						// We've received an MTS bulk tuning dump
-						mtsReceiveBulkTuningDump(&tempBuffer[4],sysexSize-4);
-					break;
-					case SYSEX_SUBID2_BULK_TUNING_DUMP_REQUEST:
-						// TODO: send a sysex MTS with our current tuning 
-					break;
-				}
+			if(id>=cpCount || i+3>n)
 				break;
-			}
-		}    
 
-		sysexSize=0;
-		refreshFullState();
+			if(id==cpSeqArpClock)
+				setContinuousBits(&settings.seqArpClock,buf[i+1]|(buf[i+2]<<8),0xfffc);
+			else
+				change|=setContinuous(id,buf[i+1]|(buf[i+2]<<8),0xfffc);
+			i+=3;
+		}
+	}
+
+	parameterChanged(change);
+}
+
+static void sysexEnd(void)
+{
+	switch(sysex.state)
+	{
+	case ssPatchDump:
+		if(sysex.groupSize)
+		{
+			sysex.group[4]=0;
+			sysexDecodeGroup();
+		}
+
+		if(sysex.size>0)
+		{
+			storage_import(sysex.number,tempBuffer,MIN(sysex.size-1,STORAGE_PAGE_SIZE));
+			refreshFullState();
+		}
+		break;
+	case ssBuffer:
+		if(tempBuffer[0]==0x01)
+		{
+			import_sysex(tempBuffer,sysex.size);
+			refreshFullState();
+		}
+		else if(tempBuffer[0]==SYSEX_ID_UNIVERSAL_NON_REALTIME)
+		{
+			// We've received an MTS bulk tuning dump
+			mtsReceiveBulkTuningDump(&tempBuffer[4],sysex.size-4);
+			refreshFullState();
+		}
+		else if(tempBuffer[3]==SYSEX_COMMAND_PATCH_DUMP_REQUEST)
+		{
+			// the preset number, its bits from the 8th on in an optional second byte
+			midi_dumpPreset((sysex.size>4?tempBuffer[4]:0)+(sysex.size>5?tempBuffer[5]<<7:0));
+		}
+		else if(tempBuffer[3]==SYSEX_COMMAND_PROFILER_REQUEST)
+		{
+			midi_dumpProfiler(sysex.size>4?tempBuffer[4]:0);
+		}
+		else if(tempBuffer[3]==SYSEX_COMMAND_PARAMETER_SNAPSHOT)
+		{
+			sysexSnapshot(&tempBuffer[4],sysex.size-4);
+		}
 		break;
 	default:
-		if(sysexSize>=MAX_SYSEX_SIZE)
+		break;
+	}
+
+	sysex.state=ssIdle;
+}
+
+static void sysexReceiveByte(uint8_t b)
+{
+	switch(b)
+	{
+	case 0xF0: // Begin SysEx message
+		sysex.state=ssHeader;
+		sysex.size=0;
+		return;
+	case 0xF7: // End SysEx message
+		if(storage_isBusy())
+			storageWait.sysexEnd=1;
+		else
+			sysexEnd();
+		return;
+	}
+
+	switch(sysex.state)
+	{
+	case ssHeader:
+	case ssBuffer:
+		if(sysex.size>=TEMP_BUFFER_SIZE)
 		{
-#ifdef DEBUG
-			print("Warning: sysex buffer overflow\n");
-#endif
-			sysexSize=0;
+			sysexReject();
+			break;
+		}
+
+		tempBuffer[sysex.size++]=b;
+
+		if(sysex.state==ssHeader)
+			sysexClassify();
+		break;
+	case ssPatchDump:
+		// a group starting past the page can't be padding
+		if(sysex.groupSize==0 && sysex.size>STORAGE_PAGE_SIZE)
+		{
+			sysexReject();
+			break;
 		}
-		
-		tempBuffer[sysexSize++]=b;
+
+		sysex.group[sysex.groupSize++]=b;
+
+		if(sysex.groupSize==5)
+			sysexDecodeGroup();
+		break;
+	default:
+		// not for us, drop it
+		break;
 	}
 }
 
@@ -250,28 +560,178 @@ static void midi_noteOffEvent(MidiDevice * device, uint8_t channel, uint8_t note
     synth_keyEvent(note,0,0,0);
 }
 
-static void midi_ccEvent(MidiDevice * device, uint8_t channel, uint8_t control, uint8_t value)
+// what refreshFullState() would have to redo for a parameter changed by CC
+static uint8_t ccRefreshGroups(int8_t stepped, int16_t param)
 {
-	int16_t param;
-	int8_t change=0;
-	
-	if(!midiFilterChannel(channel))
+	if(!stepped)
+	{
+		switch(param)
+		{
+		case cpAmpAtt: case cpAmpDec: case cpAmpSus: case cpAmpRel:
+		case cpFilAtt: case cpFilDec: case cpFilSus: case cpFilRel:
+		case cpSpread:
+			return rgEnv|rgDisplay;
+		case cpLFOAmt: case cpLFOFreq: case cpVibAmt: case cpVibFreq:
+			return rgLfo|rgDisplay;
+		case cpModDelay:
+			return rgModDelay|rgDisplay;
+		default:
+			// the other ones are read continuously by synth_update() & the timer interrupt
+			return rgDisplay;
+		}
+	}
+
+	switch(param)
+	{
+	case spASaw: case spATri: case spBSaw: case spBTri: case spSync: case spPModFil:
+		return rgGates|rgDisplay;
+	case spPModFA:
+		return rgGates|rgRouting|rgDisplay;
+	case spLFOTargets: case spVibTarget: case spEnvRouting:
+		return rgRouting|rgDisplay;
+	case spLFOShape: case spModwheelTarget:
+		return rgLfo|rgDisplay;
+	case spLFOSync:
+		return rgModDelay|rgDisplay;
+	case spAmpEnvShape: case spFilEnvShape: case spAmpEnvSlow: case spFilEnvSlow:
+		return rgEnv|rgDisplay;
+	case spUnison: case spAssignerPriority:
+		return rgAssigner|rgDisplay;
+	case spBenderSemitones: case spBenderTarget:
+		return rgPitch|rgDisplay;
+	default:
+		return rgAll;
+	}
+}
+
+// coarse/fine/full updates of a continuous parameter, the 2 low bits are always cleared
+static int8_t setContinuousBits(uint16_t * p, uint16_t value, uint16_t mask)
+{
+	if((*p&mask)==(value&mask))
+		return 0;
+
+	*p=(*p&~mask&0xfffc)|(value&mask);
+	return 1;
+}
+
+static uint8_t setContinuous(int16_t param, uint16_t value, uint16_t mask)
+{
+	preset_keepOnLoad(0,param);
+
+	if(!setContinuousBits(&currentPreset.continuousParameters[param],value,mask))
+		return 0;
+
+	return ccRefreshGroups(0,param);
+}
+
+// v: the parameter value itself, not a CC value
+static uint8_t setStepped(int16_t param, uint8_t v)
+{
+	uint8_t prev,change=0;
+
+	preset_keepOnLoad(1,param);
+
+	prev=currentPreset.steppedParameters[param];
+
+	if(prev!=v)
+	{
+		currentPreset.steppedParameters[param]=v;
+		change=ccRefreshGroups(1,param);
+	}
+
+	// special case for unison (pattern latch)
+
+	if(param==spUnison) // the switch to unison
+	{
+		if(v && !prev)
+		{
+			// only execute changes into unison mode, not additional latches
+			assigner_latchPattern(0);
+		}
+		else
+		{
+			assigner_setPoly();
+		}
+		assigner_getPattern(currentPreset.voicePattern,NULL);
+	}
+
+	return change;
+}
+
+// stepped parameter CCs divide 0-127 in as many zones as there are choices
+static uint8_t steppedFromCC(int16_t param, uint8_t value)
+{
+	return (((uint16_t)value)*steppedParameterRange[param])>>7;
+}
+
+static void parameterChanged(uint8_t change)
+{
+	if(change)
+	{
+		ui_setPresetModified(1);
+		synth_refreshLater(change);
+	}
+}
+
+// data entry for the selected NRPN, msb and lsb as a single update
+static void nrpnDataEntry(uint8_t msb, uint8_t lsb, int8_t hasLsb)
+{
+	uint16_t value,mask;
+	uint8_t param=nrpn.numberLsb;
+
+	value=((uint16_t)msb<<9)|((uint16_t)lsb<<2);
+	mask=hasLsb?0xfffc:0xfe00; // without lsb, like a coarse CC
+
+	if(nrpn.numberMsb==NRPN_CONTINUOUS_MSB && param<cpCount)
+	{
+		if(param==cpSeqArpClock) // a setting, always applied
+			setContinuousBits(&settings.seqArpClock,value,mask);
+		else if(settings.presetMode)
+			parameterChanged(setContinuous(param,value,mask));
+	}
+	else if(nrpn.numberMsb==NRPN_STEPPED_MSB && param<spCount)
+	{
+		if(settings.presetMode)
+			parameterChanged(setStepped(param,steppedFromCC(param,msb)));
+	}
+}
+
+// a data entry msb that didn't get its lsb is applied alone
+static void nrpnFlush(void)
+{
+	if(nrpn.state!=nsDataMsb)
 		return;
-	
-#ifdef DEBUG_
-	print("midi cc ");
-	phex(control);
-	print(" value ");
-	phex(value);
-	print("\n");
-#endif
 
-	if(control==0 && value<=1 && settings.presetMode!=value) // coarse bank #
+	nrpn.state=nsSelected;
+	nrpnDataEntry(nrpn.dataMsb,0,0);
+}
+
+static void setPresetMode(int8_t presetMode)
+{
+	settings.presetMode=presetMode;
+	settings_save();
+	refreshPresetMode();
+	refreshFullState();
+}
+
+// controllers outside of NRPN sequences
+static void controlChange(uint8_t control, uint8_t value)
+{
+	int16_t param;
+	uint8_t change=0;
+
+	if(control==0 && value<=2) // coarse bank #, 0: live mode, 1 & 2: preset mode with a program bank each
 	{
-		settings.presetMode=value;
-		settings_save();
-		refreshPresetMode();
-		refreshFullState();
+		if(value)
+			programBank.receive=value-1;
+
+		if(settings.presetMode!=(value>0))
+		{
+			if(storage_isBusy())
+				storageWait.presetMode=value>0;
+			else
+				setPresetMode(value>0);
+		}
 	}
 	else if(control==1) // modwheel
 	{
@@ -316,11 +776,7 @@ static void midi_ccEvent(MidiDevice * device, uint8_t channel, uint8_t control,
 	{
 		if (control-MIDI_BASE_COARSE_CC==cpSeqArpClock)
 		{
-			if((settings.seqArpClock>>9)!=value)
-			{
-				settings.seqArpClock&=0x01fc;
-				settings.seqArpClock|=(uint16_t)value<<9;
-			}
+			setContinuousBits(&settings.seqArpClock,(uint16_t)value<<9,0xfe00);
 			return;
 		}
 	}
@@ -328,11 +784,7 @@ static void midi_ccEvent(MidiDevice * device, uint8_t channel, uint8_t control,
 	{
 		if (control-MIDI_BASE_FINE_CC==cpSeqArpClock)
 		{
-			if(((settings.seqArpClock>>2)&0x7f)!=value)
-			{
-				settings.seqArpClock&=0xfe00;
-				settings.seqArpClock|=(uint16_t)value<<2;
-			}
+			setContinuousBits(&settings.seqArpClock,(uint16_t)value<<2,0x01fc);
 			return;
 		}
 	}
@@ -343,81 +795,106 @@ static void midi_ccEvent(MidiDevice * device, uint8_t channel, uint8_t control,
 	if(control>=MIDI_BASE_COARSE_CC && control<MIDI_BASE_COARSE_CC+cpCount)
 	{
 		param=control-MIDI_BASE_COARSE_CC;
-		
-		if((currentPreset.continuousParameters[param]>>9)!=value)
-		{
-			currentPreset.continuousParameters[param]&=0x01fc;
-			currentPreset.continuousParameters[param]|=(uint16_t)value<<9;
-			change=1;
-		}
+		change=setContinuous(param,(uint16_t)value<<9,0xfe00);
 	}
 	else if(control>=MIDI_BASE_FINE_CC && control<MIDI_BASE_FINE_CC+cpCount)
 	{
 		param=control-MIDI_BASE_FINE_CC;
-
-		if(((currentPreset.continuousParameters[param]>>2)&0x7f)!=value)
-		{
-			currentPreset.continuousParameters[param]&=0xfe00;
-			currentPreset.continuousParameters[param]|=(uint16_t)value<<2;
-			change=1;
-        }
+		change=setContinuous(param,(uint16_t)value<<2,0x01fc);
 	}
 	else if(control>=MIDI_BASE_STEPPED_CC && control<MIDI_BASE_STEPPED_CC+spCount)
 	{
 		param=control-MIDI_BASE_STEPPED_CC;
-		uint8_t v, prev;
-		
-        prev=currentPreset.steppedParameters[param];
-        v=(((uint16_t)value)*steppedParameterRange[param])>>7;
-		
-		if(currentPreset.steppedParameters[param]!=v)
-		{
-			currentPreset.steppedParameters[param]=v;
-			change=1;	
-		}
-		
-		// special case for unison (pattern latch)
-		
-		if(param==spUnison) // the switch to unison
-		{
-			if(v && !prev)
-			{
-                // only execute changes into unison mode, not additional latches
-				assigner_latchPattern(0);
-			}
-			else
-			{
-				assigner_setPoly();
-			}
-			assigner_getPattern(currentPreset.voicePattern,NULL);
-		}
+		change=setStepped(param,steppedFromCC(param,value));
 	}
 
+	parameterChanged(change);
+}
 
-	if(change)
-	{
-		ui_setPresetModified(1);
-		refreshFullState();
-	}
+// a CC 99 that didn't get a CC 98 right after it is the fine CC it also is
+static void nrpnFlushNumber(void)
+{
+	if(!nrpn.msbPending)
+		return;
+
+	nrpn.msbPending=0;
+	controlChange(MIDI_NRPN_MSB,nrpn.pendingMsb);
 }
 
-static void midi_progChangeEvent(MidiDevice * device, uint8_t channel, uint8_t program)
+static void midi_ccEvent(MidiDevice * device, uint8_t channel, uint8_t control, uint8_t value)
 {
 	if(!midiFilterChannel(channel))
 		return;
+	
+#ifdef DEBUG_
+	print("midi cc ");
+	phex(control);
+	print(" value ");
+	phex(value);
+	print("\n");
+#endif
+
+	// NRPN: CC 99 & 98 (right after 99) select a parameter, CC 6 & 38 (right after 6) set it
+	// 99, 98 and 38 keep their parameter meaning otherwise
+
+	if(control==MIDI_NRPN_LSB && nrpn.msbPending)
+	{
+		nrpn.msbPending=0;
+		nrpn.numberMsb=nrpn.pendingMsb;
+		nrpn.numberLsb=value;
+		nrpn.state=nsSelected;
+		return;
+	}
+
+	nrpnFlushNumber();
 
-	if(settings.presetMode && program<100  && program!=settings.presetNumber)
+	if(control==MIDI_DATA_ENTRY_LSB && nrpn.state==nsDataMsb)
 	{
-		if (preset_checkPage(program)) // ignore MIDI prog change if the page is not valid
+		nrpn.state=nsSelected;
+		nrpnDataEntry(nrpn.dataMsb,value,1);
+		return;
+	}
+
+	nrpnFlush();
+
+	if(control==MIDI_NRPN_MSB)
+	{
+		// it's only known with the next CC
+		nrpn.pendingMsb=value;
+		nrpn.msbTick=currentTick;
+		nrpn.msbPending=1;
+		return;
+	}
+	else if(control==MIDI_DATA_ENTRY_MSB)
+	{
+		if(nrpn.state==nsSelected)
 		{
-			preset_loadCurrent(program,0);
-			settings.presetNumber=program;
-			ui_setPresetModified(0);
-			refreshFullState();
-			ui_setNoActivePot(1);
-			ui.presetModified=0;
+			nrpn.dataMsb=value;
+			nrpn.dataTick=currentTick;
+			nrpn.state=nsDataMsb;
 		}
+		return;
 	}
+
+	controlChange(control,value);
+}
+
+static void midi_progChangeEvent(MidiDevice * device, uint8_t channel, uint8_t program)
+{
+	int16_t number,preset;
+
+	if(!midiFilterChannel(channel))
+		return;
+
+	number=preset_getPendingLoad();
+	if(number<0)
+		number=settings.presetNumber;
+
+	preset=programBank.receive*PROGRAM_BANK_SIZE+program;
+
+	// read by the main loop, so that the EEPROM doesn't stall us, empty presets are ignored (the directory is in RAM)
+	if(settings.presetMode && preset<PRESET_COUNT && preset!=number && preset_checkPage(preset))
+		preset_loadLater(preset);
 }
 
 static void midi_pitchBendEvent(MidiDevice * device, uint8_t channel, uint8_t v1, uint8_t v2)
@@ -436,16 +913,24 @@ static void midi_pitchBendEvent(MidiDevice * device, uint8_t channel, uint8_t v1
 
 static void midi_sysexEvent(MidiDevice * device, uint16_t count, uint8_t b0, uint8_t b1, uint8_t b2)
 {
-	if(sysexSize)
-		count=count-sysexSize-1;
-	
-	if(count>0)
+	uint16_t received;
+
+	// xnormidi gives us the message 3 bytes at a time, with its total count so far
+	// (a message cut by another status byte never ends, the next one starts with 0xF0)
+
+	if(b0==0xF0 && count<=3)
+		sysex.count=0;
+
+	received=count-sysex.count;
+	sysex.count=count;
+
+	if(received>0)
 		sysexReceiveByte(b0);
-	
-	if(count>1)
+
+	if(received>1)
 		sysexReceiveByte(b1);
 
-	if(count>2)
+	if(received>2)
 		sysexReceiveByte(b2);
 }
 
@@ -456,14 +941,36 @@ static void midi_realtimeEvent(MidiDevice * device, uint8_t event)
 
 static void midi_sendFunc(MidiDevice * device, uint16_t count, uint8_t b0, uint8_t b1, uint8_t b2)
 {
-	if(count>0)
-		sendEnqueue(b0);
+	// senders run from the main loop and the timer interrupt, keep messages whole
 	
-	if(count>1)
-		sendEnqueue(b1);
+	BLOCK_INT
+	{
+		if(count>0)
+		{
+#ifdef MIDI_RUNNING_STATUS
+			if(b0>=0xf8)
+			{
+				// realtime, doesn't affect running status
+				sendEnqueue(b0);
+			}
+			else if(b0!=sendRunningStatus || currentTick-sendRunningStatusTick>=RUNNING_STATUS_REFRESH_TICKS)
+			{
+				// system common messages cancel running status
+				sendRunningStatus=(b0<0xf0)?b0:0;
+				sendRunningStatusTick=currentTick;
+				sendEnqueue(b0);
+			}
+#else
+			sendEnqueue(b0);
+#endif
+		}
 
-	if(count>2)
-		sendEnqueue(b2);
+		if(count>1)
+			sendEnqueue(b1);
+
+		if(count>2)
+			sendEnqueue(b2);
+	}
 }
 
 
@@ -479,23 +986,63 @@ void midi_init(void)
 	midi_register_sysex_callback(&midi,midi_sysexEvent);
 	midi_register_realtime_callback(&midi,midi_realtimeEvent);
 	
-	sysexSize=0;
+	sysex.state=ssIdle;
 	
-	bytequeue_init(&sendQueue, sendQueueData, sizeof(sendQueueData));
+	spscqueue_init(&sendQueue, sendQueueData, sizeof(sendQueueData));
+
+	dump.number=-1;
+
+	programBank.receive=0;
+	programBank.send=0;
+
+	nrpn.state=nsIdle;
+	nrpn.msbPending=0;
+	panel.nrpnMsb=0xff;
+
+	storageWait.sysexEnd=0;
+	storageWait.presetMode=-1;
 }
 
-void midi_update(int8_t onlySend)
+void midi_update(void)
 {
-	if(!onlySend)
-		midi_device_process(&midi);
-	
-	if(bytequeue_length(&sendQueue)>0)
+	uint8_t b;
+
+	// what waited for the storage goes first
+
+	if(!storage_isBusy())
 	{
-		uint8_t b;
-		b=bytequeue_get(&sendQueue,0);
-		bytequeue_remove(&sendQueue,1);
-		uart_send(b);
+		if(storageWait.sysexEnd)
+		{
+			storageWait.sysexEnd=0;
+			sysexEnd();
+		}
+
+		if(storageWait.presetMode>=0)
+		{
+			setPresetMode(storageWait.presetMode);
+			storageWait.presetMode=-1;
+		}
 	}
+
+	// then the input, a byte at a time, so that it stops right after a message that has to wait
+
+	while(!storageWait.sysexEnd && storageWait.presetMode<0 && spscqueue_length(&midi.input_queue))
+	{
+		b=spscqueue_get(&midi.input_queue,0);
+		midi_process_byte(&midi,b);
+		spscqueue_remove(&midi.input_queue,1);
+	}
+
+	if(nrpn.state==nsDataMsb && currentTick-nrpn.dataTick>=NRPN_LSB_TIMEOUT_TICKS)
+		nrpnFlush();
+
+	if(nrpn.msbPending && currentTick-nrpn.msbTick>=NRPN_LSB_TIMEOUT_TICKS)
+		nrpnFlushNumber();
+	
+	// sending is done from the UART interrupt, just make sure it runs (uart_init() stops it)
+
+	if(spscqueue_length(&sendQueue)>0)
+		uart_setTxInterrupt(1);
 }
 
 void midi_newData(uint8_t data)
@@ -503,11 +1050,11 @@ void midi_newData(uint8_t data)
 	midi_device_input(&midi,1,&data);
 }
 
-uint8_t midi_dumpPreset(int8_t number)
+uint8_t midi_dumpPreset(int16_t number)
 {
 	int16_t size=0;
 	
-	if(number<0 || number>99)
+	if(number<0 || number>=PRESET_COUNT)
 		return 0;
 
     if(preset_checkPage(number))
@@ -519,32 +1066,116 @@ uint8_t midi_dumpPreset(int8_t number)
     return 0;
 }
 
+void midi_dumpProfiler(int8_t reset)
+{
+	int16_t size;
+
+	size=profiler_dump(tempBuffer);
+	sysexSend(SYSEX_COMMAND_PROFILER_DUMP,size);
+
+	if(reset==1)
+		profiler_reset();
+}
+
 void midi_dumpPresets(void)
 {
-	int8_t i;
-	int16_t size=0;
+	if(dump.number>=0)
+		return;
+
+	dump.number=0;
+}
+
+void midi_dumpUpdate(void)
+{
+	int16_t size,i;
+	uint8_t * record;
+	uint8_t j,group[4];
+	int8_t sent=0;
+
+	if(dump.number<0)
+		return;
+
+	// empty presets are skipped from the directory, no page read for them
+
+	while(dump.number<PRESET_COUNT && !preset_checkPage(dump.number))
+		++dump.number;
+
+	if(dump.number>=PRESET_COUNT)
+	{
+		dump.number=-1;
+		sevenSeg_scrollText("presets dumped",1);
+		return;
+	}
+
+	// each sysex is queued whole, other messages can't end up in it, so it waits for room
+
+	if(SEND_QUEUE_SIZE-1-spscqueue_length(&sendQueue)<DUMP_SEND_RESERVE+DUMP_SYSEX_SIZE(PRESET_RECORD_SIZE+1))
+		return;
+
+	size=storage_exportBegin(dump.number,&record)+1; // the preset number comes first
+
+	if(DUMP_SYSEX_SIZE(size)>SEND_QUEUE_SIZE-1-DUMP_SEND_RESERVE)
+	{
+		// an older preset page that would never fit, they are 144 bytes at most
+		storage_exportEnd();
+		++dump.number;
+		return;
+	}
 
-	for(i=0;i<100;++i)
+	BLOCK_INT
 	{
-		if(preset_loadCurrent(i,0))
+		// senders in interrupts may have taken the room during the read, it is tried again next time (from the page cache)
+
+		if(SEND_QUEUE_SIZE-1-spscqueue_length(&sendQueue)>=DUMP_SEND_RESERVE+DUMP_SYSEX_SIZE(size))
 		{
-			storage_export(i,tempBuffer,&size);
-			sysexSend(SYSEX_COMMAND_PATCH_DUMP,size);
+			sysexSendHeader(SYSEX_COMMAND_PATCH_DUMP);
+
+			for(i=0;i<size;i+=4)
+			{
+				for(j=0;j<4;++j)
+					group[j]=(i+j==0)?dump.number:((i+j<size)?record[i+j-1]:0);
+				sysexSendGroup(group,size-i);
+			}
+
+			sendEnqueue(0xf7);
+			sent=1;
 		}
 	}
+
+	storage_exportEnd();
+
+	if(sent)
+	{
+		sevenSeg_setPresetNumber(dump.number,0);
+		++dump.number;
+	}
 }
 
 void midi_sendNoteEvent(uint8_t note, int8_t gate, uint16_t velocity)
 {
 	if(gate)
 		midi_send_noteon(&midi,settings.midiSendChannel,note,velocity>>9);
+#ifdef MIDI_RUNNING_STATUS
+	else // note on with velocity 0 keeps the running status, there is no release velocity anyway
+		midi_send_noteon(&midi,settings.midiSendChannel,note,0);
+#else
 	else
 		midi_send_noteoff(&midi,settings.midiSendChannel,note,velocity>>9);
+#endif
 }
 
-void midi_sendProgChange(uint8_t prog)
+void midi_sendProgChange(uint16_t number)
 {
-    midi_send_programchange(&midi, settings.midiSendChannel, prog);
+	// up to 127 in the first bank, like a single bank receiver expects
+	uint8_t bank=(number>0x7f)?1:0;
+
+	if(bank!=programBank.send)
+	{
+		midi_send_cc(&midi,settings.midiSendChannel,0,bank+1);
+		programBank.send=bank;
+	}
+
+    midi_send_programchange(&midi, settings.midiSendChannel, number-bank*PROGRAM_BANK_SIZE);
 }
 
 
@@ -579,6 +1210,111 @@ void midi_sendWheelEvent(int16_t bend, uint16_t modulation, uint8_t mask)
 	}
 }
 
+// returns 0 when it doesn't fit in the budget
+static int8_t panelSend(uint8_t param)
+{
+	uint16_t value=currentPreset.continuousParameters[param];
+	int8_t select;
+	uint8_t cost;
+#ifdef MIDI_PANEL_NRPN
+	int8_t nrpn=1;
+#else
+	// those coarse CCs are stepped ones, or CCs a receiver takes as NRPN ones (see midi_ccEvent())
+	int8_t nrpn=MIDI_BASE_COARSE_CC+param>=MIDI_BASE_STEPPED_CC || MIDI_BASE_COARSE_CC+param==MIDI_DATA_ENTRY_LSB ||
+			MIDI_BASE_FINE_CC+param==MIDI_NRPN_LSB || MIDI_BASE_FINE_CC+param==MIDI_NRPN_MSB;
+#endif
+
+	// the NRPN number is only sent when it changes, or once in a while for receivers that joined late
+
+	select=nrpn && (panel.nrpnMsb!=NRPN_CONTINUOUS_MSB || panel.nrpnLsb!=param ||
+			currentTick-panel.nrpnTick>=RUNNING_STATUS_REFRESH_TICKS);
+
+#ifdef MIDI_RUNNING_STATUS
+	cost=1+(select?8:4); // with a status byte
+#else
+	cost=select?12:6;
+#endif
+
+	if(cost>panel.budget)
+		return 0;
+
+	panel.budget-=cost;
+
+	if(select)
+	{
+		midi_send_cc(&midi,settings.midiSendChannel,MIDI_NRPN_MSB,NRPN_CONTINUOUS_MSB);
+		midi_send_cc(&midi,settings.midiSendChannel,MIDI_NRPN_LSB,param);
+		panel.nrpnMsb=NRPN_CONTINUOUS_MSB;
+		panel.nrpnLsb=param;
+		panel.nrpnTick=currentTick;
+	}
+
+	if(nrpn)
+	{
+		midi_send_cc(&midi,settings.midiSendChannel,MIDI_DATA_ENTRY_MSB,value>>9);
+		midi_send_cc(&midi,settings.midiSendChannel,MIDI_DATA_ENTRY_LSB,(value>>2)&0x7f);
+	}
+	else
+	{
+		if((value^panel.last[param])&0xfe00)
+			midi_send_cc(&midi,settings.midiSendChannel,MIDI_BASE_COARSE_CC+param,value>>9);
+		if((value^panel.last[param])&0x01fc)
+			midi_send_cc(&midi,settings.midiSendChannel,MIDI_BASE_FINE_CC+param,(value>>2)&0x7f);
+	}
+
+	panel.last[param]=value;
+
+	return 1;
+}
+
+// panel moves, bits: resolution of the pot
+void midi_sendContinuousParameter(uint8_t param, uint16_t value, uint8_t bits)
+{
+	uint16_t mask;
+
+	// like midi_sendWheelEvent(), changes in the last bit of the pot aren't sent
+
+	bits=MAX(bits-1,7);
+	mask=UINT16_MAX<<(16-bits);
+
+	if((value&mask)==(panel.last[param]&mask))
+		return;
+
+	panel.pending[param>>3]|=1<<(param&7);
+
+	midi_sendUpdate();
+}
+
+void midi_sendUpdate(void)
+{
+	uint8_t i,param;
+	uint32_t ticks;
+
+	ticks=MIN(currentTick-panel.budgetTick,PANEL_BURST_BYTES);
+	panel.budgetTick=currentTick;
+	panel.budget=MIN(panel.budget+ticks*PANEL_BYTES_PER_TICK,PANEL_BURST_BYTES);
+
+	// the latest value of each parameter is sent when there is room, notes first
+
+	if(spscqueue_length(&sendQueue)>PANEL_QUEUE_LIMIT)
+		return;
+
+	for(i=0;i<cpCount;++i)
+	{
+		param=panel.next;
+
+		if(panel.pending[param>>3]&(1<<(param&7)))
+		{
+			if(!panelSend(param))
+				return;
+
+			panel.pending[param>>3]&=~(1<<(param&7));
+		}
+
+		panel.next=(param+1)%cpCount;
+	}
+}
+
 void midi_sendSustainEvent(int8_t on)
 {
 	midi_send_cc(&midi,settings.midiSendChannel,64,on?0x7f:0x00);
@@ -4,14 +4,21 @@
 #include "synth.h"
 
 void midi_init(void);
-void midi_update(int8_t onlySend);
+void midi_update(void);
 void midi_newData(uint8_t data);
-uint8_t midi_dumpPreset(int8_t number);
-void midi_dumpPresets(void);
+int8_t midi_nextSendByte(uint8_t * b); // returns 0 if the send queue is empty
+void midi_getSendStats(uint8_t * highWater, uint16_t * overflows);
+void midi_resetSendStats(void);
+uint8_t midi_dumpPreset(int16_t number);
+void midi_dumpPresets(void); // starts a background bulk dump
+void midi_dumpUpdate(void); // main loop
+void midi_dumpProfiler(int8_t reset);
 void midi_sendNoteEvent(uint8_t note, int8_t gate, uint16_t velocity);
 void midi_sendWheelEvent(int16_t bend, uint16_t modulation, uint8_t mask);
+void midi_sendContinuousParameter(uint8_t param, uint16_t value, uint8_t bits); // panel moves, bits: pot resolution
+void midi_sendUpdate(void); // main loop, panel moves within their byte budget
 void midi_sendSustainEvent(int8_t on);
-void midi_sendProgChange(uint8_t prog);
+void midi_sendProgChange(uint16_t number); // with a bank select first when the bank changes
 void midi_sendThreeBytes(uint8_t mdchn, uint16_t val);
 
 #endif	/* MIDI_H */
@@ -8,7 +8,17 @@
 
 #define CHANGE_DETECT_THRESHOLD 4
 
-static const int8_t potBitDepth[POTMUX_POT_COUNT]=
+// 16bit scale, finer than the change detector so that slow sweeps are caught by the scheduler
+#define MOVE_DETECT_THRESHOLD 0x0100
+
+// coarse pots need that many LSBs, or a smaller step in the same direction as the last one,
+// so that 1 LSB of jitter isn't a move but a slow sweep still is
+#define MOVE_DETECT_LSBS 2
+
+// rounds of a tracking conversion, the window is 2^(TRACK_ROUNDS-1) LSBs wide
+#define TRACK_ROUNDS 4
+
+static const PROGMEM int8_t potBitDepth[POTMUX_POT_COUNT]=
 {
     /*Vol A / Mixer*/8,
     /*Cutoff*/12,
@@ -45,65 +55,89 @@ static const int8_t potBitDepth[POTMUX_POT_COUNT]=
 
 };
 
-static const int8_t response[POTMUX_POT_COUNT]=
-{
-    /*Vol A*/6,
-    /*Cutoff*/4,
-    /*Resonance*/3,
-    /*Fil Env Amt*/6,
-    /*Filter Release */35,
-    /*Filter Sustain*/6,
-    /*Filter Decay*/35,
-    /*Filter Attack*/35,
-    /*Amp Release*/35,
-    /*Amp Sustain*/6,
-    /*Amp Decay*/35,
-    /*Amp Attack*/35,
-    /*Vol B*/6,
-    /*BPW*/7,
-    /*Master Vol*/6,
-    /*Master Tune*/11,
-    /*Pitch Bender*/3,
+// slowest scan interval, in potmux_update() calls, a still pot decays to
+static const PROGMEM uint8_t potIdleInterval[POTMUX_POT_COUNT]=
+{
+    /*Vol A*/12,
+    /*Cutoff*/8,
+    /*Resonance*/6,
+    /*Fil Env Amt*/12,
+    /*Filter Release */70,
+    /*Filter Sustain*/12,
+    /*Filter Decay*/70,
+    /*Filter Attack*/70,
+    /*Amp Release*/70,
+    /*Amp Sustain*/12,
+    /*Amp Decay*/70,
+    /*Amp Attack*/70,
+    /*Vol B*/12,
+    /*BPW*/14,
+    /*Master Vol*/12,
+    /*Master Tune*/22,
+    /*Pitch Bender*/6,
     0,
     0,
     0,
     0,
     0,
-    /*Mod Wheel*/3,
-    /*Data Dial*/8,
-    /*APW*/7,
-    /*Poly-Mod Env*/8,
-    /*Poly-Mod OSC B*/3,
-    /*LFO Frequency*/20,
-    /*LFO Amount*/6,
-    /*Frequency B*/3,
-    /*Frequency A*/3,
-    /*Frequency B Fine*/20,
+    /*Mod Wheel*/6,
+    /*Data Dial*/16,
+    /*APW*/14,
+    /*Poly-Mod Env*/16,
+    /*LFO Frequency*/6,
+    /*Poly-Mod OSC B*/40,
+    /*LFO Amount*/12,
+    /*Frequency B*/6,
+    /*Frequency A*/6,
+    /*Frequency B Fine*/40,
 };
 
 
 static struct
 {
 	uint32_t potChanged;
+	uint32_t trackable; // pots[] holds a valid previous value
+	uint32_t rising; // last change of pots[] was up
 	uint8_t changeDetect[POTMUX_POT_COUNT];
 
 	uint16_t pots[POTMUX_POT_COUNT];
 	uint8_t potExcited[POTMUX_POT_COUNT];
-	uint8_t potcounter[POTMUX_POT_COUNT];
-	int8_t currentRegularPot;
+	uint8_t potcounter[POTMUX_POT_COUNT]; // potmux_update() calls until next scan, 0: due
+	uint8_t scanInterval[POTMUX_POT_COUNT];
+	uint8_t activeScans[POTMUX_POT_COUNT]; // still scans left at full rate
+	int8_t nextIdlePot; // round robin start, so that pots deferred by the budget go first
 	int8_t lastChanged;
 	int8_t lastInAction;
 
+	uint32_t conversions;
+	uint32_t rounds;
+	uint8_t peakRounds; // per potmux_update() call
 } potmux;
 
-static void updatePot(int8_t pot)
+static inline int8_t isDACLower(uint16_t value)
+{
+	dac_write(value);
+
+	// let comparator get correct voltage (don't remove me!)
+	CYCLE_WAIT(2);
+
+	// is DAC value lower than pot value?
+	return (io_read(0x09)&0x08)!=0;
+}
+
+// returns DAC/comparator rounds used, the pot is left due (potmux.trackable bit clear)
+// when its value moved out of the tracking window and the budget can't afford a full conversion
+static uint8_t updatePot(int8_t pot, uint8_t budget)
 {
 	int8_t i,lower;
-	uint8_t mux,bitDepth,cdv,diff;
-	uint16_t estimate,badMask;
+	uint8_t mux,bitDepth,cdv,diff,rounds,used;
+	uint16_t estimate,badMask,delta,half,moveThreshold;
 	uint16_t bit;
+	uint32_t potMask;
+
+    if (pot<0) return 0;
 
-    if (pot<0) return;
+	used=0;
 
 	BLOCK_INT
 	{
@@ -117,27 +151,61 @@ static void updatePot(int8_t pot)
 
 			// init values
 
-		estimate=UINT16_MAX;
-		bit=0x8000;
-		bitDepth=potBitDepth[pot];
+		bitDepth=pgm_read_byte(&potBitDepth[pot]);
 		badMask=16-bitDepth;
 		badMask=(UINT16_MAX>>badMask)<<badMask;
+		potMask=(uint32_t)1<<pot;
+		rounds=0;
 
+			// tracking: search only a window around the previous value, this gives
+			// the same result as the full search as long as the pot is inside it
 
-			// main loop
-
-		for(i=0;i<=bitDepth;++i)
+		if((potmux.trackable&potMask) && TRACK_ROUNDS+1<=budget)
 		{
-			dac_write(estimate);
+			half=(uint16_t)1<<(16-bitDepth+TRACK_ROUNDS-2);
+			estimate=potmux.pots[pot];
+			estimate=(estimate>half)?estimate-half:0;
+			estimate=MIN(estimate,(uint16_t)(0-2*half));
+
+			// pot must be above the window bottom...
+
+			lower=1;
+			if(estimate)
+			{
+				lower=isDACLower(estimate);
+				++used;
+			}
+
+			// ... and below its top, that is also the first round of the search
+
+			if(lower)
+			{
+				estimate+=2*half-1;
+				++used;
+				if(!isDACLower(estimate))
+				{
+					estimate-=half;
+					bit=half>>1;
+					rounds=TRACK_ROUNDS-1;
+				}
+			}
+		}
+
+		potmux.trackable&=~potMask;
 
-			// let comparator get correct voltage (don't remove me!)
-			CYCLE_WAIT(2);
+		if(!rounds && used+bitDepth+1<=budget)
+		{
+			estimate=UINT16_MAX;
+			bit=0x8000;
+			rounds=bitDepth+1;
+		}
 
-			// is DAC value lower than pot value?
-			lower=(io_read(0x09)&0x08)!=0;
+			// main loop
 
+		for(i=0;i<rounds;++i)
+		{
 			// adjust estimate
-			if (lower)
+			if (isDACLower(estimate))
 				estimate+=bit;
 			else
 				estimate-=bit;
@@ -151,31 +219,66 @@ static void updatePot(int8_t pot)
 		io_write(0x0a,0xff);
 		CYCLE_WAIT(4);
 
-        // suppress the bits beyond the measurement accuracy
-		estimate&=badMask;
+		used+=rounds;
+		potmux.rounds+=used;
 
-        // change detector
-		cdv=estimate>>8;
-        diff = abs(potmux.changeDetect[pot]-cdv);
-		if (potmux.lastInAction!=pot) potmux.potExcited[pot]=0;
-		if(diff>CHANGE_DETECT_THRESHOLD || (potmux.potExcited[pot] && pot!=ppPitchWheel))
+		if(rounds)
 		{
-			potmux.changeDetect[pot]=cdv;
-			potmux.potChanged|=(uint32_t)1<<pot;
-            potmux.potExcited[pot]=1;
-            potmux.lastChanged=pot; // this is reset in every cycle, this is used to decide which value to show on the display
-            potmux.lastInAction=pot; // this stays and is only reset for a change of mode
+			// suppress the bits beyond the measurement accuracy
+			estimate&=badMask;
+
+			// change detector
+			cdv=estimate>>8;
+			diff = abs(potmux.changeDetect[pot]-cdv);
+			if (potmux.lastInAction!=pot) potmux.potExcited[pot]=0;
+			if(diff>CHANGE_DETECT_THRESHOLD || (potmux.potExcited[pot] && pot!=ppPitchWheel))
+			{
+				potmux.changeDetect[pot]=cdv;
+				potmux.potChanged|=potMask;
+				potmux.potExcited[pot]=1;
+				potmux.lastChanged=pot; // this is reset in every cycle, this is used to decide which value to show on the display
+				potmux.lastInAction=pot; // this stays and is only reset for a change of mode
+			}
+
+			if (estimate>=0xFC00)
+				estimate=badMask; // choose max value above the threshold UINT16_t - CHANGE_DETECT_THRESHOLD
+
+			// scheduler: full rate while moving, then slow down to the idle interval
+
+			moveThreshold=MAX(MOVE_DETECT_THRESHOLD,(uint16_t)MOVE_DETECT_LSBS<<(16-bitDepth));
+			delta=(estimate>potmux.pots[pot])?estimate-potmux.pots[pot]:potmux.pots[pot]-estimate;
+			if(delta>=MOVE_DETECT_THRESHOLD && !(potmux.rising&potMask)==!(estimate>potmux.pots[pot]))
+				moveThreshold=MOVE_DETECT_THRESHOLD;
+
+			if(estimate!=potmux.pots[pot])
+			{
+				if(estimate>potmux.pots[pot])
+					potmux.rising|=potMask;
+				else
+					potmux.rising&=~potMask;
+			}
+
+			if(delta>=moveThreshold || potmux.potExcited[pot])
+			{
+				potmux.activeScans[pot]=POTMUX_ACTIVE_SCANS;
+				potmux.scanInterval[pot]=1;
+			}
+			else if(potmux.activeScans[pot])
+			{
+				--potmux.activeScans[pot];
+			}
+			else
+			{
+				potmux.scanInterval[pot]=MIN(potmux.scanInterval[pot]*2,pgm_read_byte(&potIdleInterval[pot]));
+			}
+
+			potmux.pots[pot]=estimate;
+			potmux.trackable|=potMask;
+			++potmux.conversions;
 		}
+	}
 
-        if (estimate>=0xFC00)
-        {
-            potmux.pots[pot]=badMask; // choose max value above the threshold UINT16_t - CHANGE_DETECT_THRESHOLD
-        }
-        else
-        {
-            potmux.pots[pot]=estimate;
-        }
-    }
+	return used;
 }
 
 FORCEINLINE uint16_t potmux_getValue(p600Pot_t pot)
@@ -225,21 +328,103 @@ int8_t potmux_isPotZeroCentered(p600Pot_t pot, uint8_t layout)
 	return pot==ppFilEnvAmt || pot==ppPModFilEnv || pot==ppFreqBFine || pot==ppMTune || pot==ppPitchWheel || (pot==ppMixer && layout==1);
 }
 
-inline void potmux_update(uint8_t updateAll)
+uint8_t potmux_getScanInterval(p600Pot_t pot)
 {
-	int16_t i;
+	return potmux.scanInterval[pot];
+}
 
-    for(i=0;i<POTMUX_POT_COUNT;++i)
-    {
-        if (response[i]!=0)
-        {
-            if (potmux.potcounter[i]==0 || potmux.potExcited[i] || updateAll)
-            {
-                updatePot(i);
-            }
-        }
-        potmux.potcounter[i]=(potmux.potcounter[i]+1)%(2*response[i]);
-    }
+uint8_t potmux_getBitDepth(p600Pot_t pot)
+{
+	return pgm_read_byte(&potBitDepth[pot]);
+}
+
+void potmux_getStats(uint32_t * conversions, uint32_t * rounds, uint8_t * peakRounds)
+{
+	BLOCK_INT
+	{
+		*conversions=potmux.conversions;
+		*rounds=potmux.rounds;
+		*peakRounds=potmux.peakRounds;
+	}
+}
+
+void potmux_resetStats(void)
+{
+	BLOCK_INT
+	{
+		potmux.conversions=0;
+		potmux.rounds=0;
+		potmux.peakRounds=0;
+	}
+}
+
+static inline uint8_t schedulePot(int8_t pot, uint8_t budget)
+{
+	uint8_t r,cost;
+
+	// cheapest attempt, a tracking conversion when possible
+
+	cost=(potmux.trackable&((uint32_t)1<<pot))?TRACK_ROUNDS+1:pgm_read_byte(&potBitDepth[pot])+1;
+
+	if(potmux.potcounter[pot] || cost>budget)
+		return 0;
+
+	r=updatePot(pot,budget);
+	if(potmux.trackable&((uint32_t)1<<pot))
+		potmux.potcounter[pot]=potmux.scanInterval[pot];
+	return r;
+}
+
+void potmux_update(uint8_t updateAll)
+{
+	int8_t i,pot,deferred;
+	uint8_t budget,r;
+
+	if(updateAll)
+	{
+		for(i=0;i<POTMUX_POT_COUNT;++i)
+			if(potmux.scanInterval[i])
+			{
+				updatePot(i,UINT8_MAX);
+				potmux.potcounter[i]=potmux.scanInterval[i];
+			}
+		return;
+	}
+
+	// age counters, a pot is due when its counter reaches 0
+
+	for(i=0;i<POTMUX_POT_COUNT;++i)
+		if(potmux.potcounter[i])
+			--potmux.potcounter[i];
+
+	budget=POTMUX_STEP_BUDGET;
+
+	// moving pots go first, so that sweeps are tracked at full rate
+
+	for(i=0;i<POTMUX_POT_COUNT;++i)
+		if(potmux.scanInterval[i]==1)
+			budget-=schedulePot(i,budget);
+
+	// then the slower ones, round robin, leaving the remainder due for the next call
+
+	deferred=-1;
+	pot=potmux.nextIdlePot;
+	for(i=0;i<POTMUX_POT_COUNT;++i)
+	{
+		if(potmux.scanInterval[pot]>1)
+		{
+			r=schedulePot(pot,budget);
+			budget-=r;
+			if(!potmux.potcounter[pot] && deferred<0)
+				deferred=pot;
+		}
+		pot=(pot+1)%POTMUX_POT_COUNT;
+	}
+
+	if(deferred>=0)
+		potmux.nextIdlePot=deferred;
+
+	potmux.peakRounds=MAX(potmux.peakRounds,POTMUX_STEP_BUDGET-budget);
 }
 
 void potmux_init(void)
@@ -250,6 +435,7 @@ void potmux_init(void)
 
     for (i=0;i<POTMUX_POT_COUNT;++i)
     {
-        potmux.potcounter[i]=i; // distribute the pots as evenly as possible
+        potmux.scanInterval[i]=pgm_read_byte(&potIdleInterval[i]);
+        potmux.potcounter[i]=i%(potmux.scanInterval[i]+1); // distribute the pots as evenly as possible
     }
 }
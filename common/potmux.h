@@ -5,6 +5,10 @@
 
 #define POTMUX_POT_COUNT 32
 
+// scheduler tuning
+#define POTMUX_STEP_BUDGET 40 // DAC/comparator rounds per potmux_update() call, about the former average load
+#define POTMUX_ACTIVE_SCANS 32 // still scans at full rate before a pot that moved starts slowing down
+
 uint16_t potmux_getValue(p600Pot_t pot);
 
 int8_t potmux_hasChanged(p600Pot_t pot);
@@ -16,6 +20,10 @@ void potmux_resetSpeedPot(void);
 void potmux_init(void);
 
 void potmux_update(uint8_t updateAll);
+uint8_t potmux_getScanInterval(p600Pot_t pot); // in potmux_update() calls
+uint8_t potmux_getBitDepth(p600Pot_t pot);
+void potmux_getStats(uint32_t * conversions, uint32_t * rounds, uint8_t * peakRounds);
+void potmux_resetStats(void);
 uint8_t comparePotVal(p600Pot_t pot, uint16_t potValue, uint16_t compareValue);
 
 int8_t potmux_isPotZeroCentered(p600Pot_t pot, uint8_t layout);
@@ -0,0 +1,165 @@
+////////////////////////////////////////////////////////////////////////////////
+// Cycle accounting for the timer interrupt, read back through sysex
+////////////////////////////////////////////////////////////////////////////////
+
+#include "profiler.h"
+#include "sh.h"
+#include "potmux.h"
+#include "midi.h"
+#include "storage.h"
+
+#define PROFILER_DUMP_VERSION 5
+
+static struct
+{
+	struct profilerStats_s stats[prsCount];
+	uint16_t start,last;
+	uint16_t overruns;
+} profiler;
+
+static void record(profilerSection_t section, uint16_t cycles)
+{
+	struct profilerStats_s * s=&profiler.stats[section];
+
+	// keep a running average once the counter would overflow
+
+	if(s->count==UINT16_MAX)
+	{
+		s->count>>=1;
+		s->sum>>=1;
+	}
+
+	++s->count;
+	s->sum+=cycles;
+	s->min=MIN(s->min,cycles);
+	s->max=MAX(s->max,cycles);
+}
+
+void profiler_reset(void)
+{
+	int8_t i;
+
+	BLOCK_INT
+	{
+		memset(&profiler,0,sizeof(profiler));
+
+		for(i=0;i<prsCount;++i)
+			profiler.stats[i].min=UINT16_MAX;
+	}
+
+	sh_resetStats();
+	potmux_resetStats();
+	midi_resetSendStats();
+	storage_resetCacheStats();
+}
+
+#ifdef PROFILER
+
+void profiler_start(void)
+{
+	profiler.start=profiler.last=CYCLE_COUNT();
+}
+
+void profiler_lap(profilerSection_t section)
+{
+	uint16_t now=CYCLE_COUNT();
+
+	record(section,now-profiler.last);
+	profiler.last=now;
+}
+
+void profiler_end(void)
+{
+	uint16_t cycles=CYCLE_COUNT()-profiler.start;
+
+	record(prsTotal,cycles);
+
+	if(cycles>CYCLE_COUNT_PER_TICK)
+		++profiler.overruns;
+}
+
+#endif
+
+uint16_t profiler_getAverage(profilerSection_t section)
+{
+	const struct profilerStats_s * s=&profiler.stats[section];
+
+	if(!s->count)
+		return 0;
+
+	return s->sum/s->count;
+}
+
+const struct profilerStats_s * profiler_getStats(profilerSection_t section)
+{
+	return &profiler.stats[section];
+}
+
+uint16_t profiler_getOverruns(void)
+{
+	return profiler.overruns;
+}
+
+static uint8_t * write16(uint8_t * buf, uint16_t v)
+{
+	*buf++=v;
+	*buf++=v>>8;
+	return buf;
+}
+
+static uint8_t * write32(uint8_t * buf, uint32_t v)
+{
+	buf=write16(buf,v);
+	return write16(buf,v>>16);
+}
+
+int16_t profiler_dump(uint8_t * buf)
+{
+	uint8_t * p=buf;
+	int8_t i;
+	uint32_t shWrites,shSkips,potConversions,potRounds;
+	uint32_t cacheHits,cacheMisses,cacheFlushes,storageWrites;
+	uint8_t potPeak,sendHighWater,storagePending;
+	uint16_t sendOverflows,storageOldest;
+
+	// version, section count, budget, overruns, then min/avg/max for each section,
+	// then S&H writes and skipped writes, pot conversions and DAC/comparator rounds (32 bit),
+	// then MIDI send queue high water and overflows (16 bit),
+	// then storage cache hits, misses, pages written to the cache and committed to the EEPROM (32 bit),
+	// pages waiting to be committed and the age of the oldest one in ticks (16 bit), LSB first
+
+	*p++=PROFILER_DUMP_VERSION;
+	*p++=prsCount;
+	p=write16(p,CYCLE_COUNT_PER_TICK);
+	p=write16(p,profiler.overruns);
+
+	for(i=0;i<prsCount;++i)
+	{
+		p=write16(p,profiler.stats[i].count?profiler.stats[i].min:0);
+		p=write16(p,profiler_getAverage(i));
+		p=write16(p,profiler.stats[i].max);
+	}
+
+	sh_getStats(&shWrites,&shSkips);
+	p=write32(p,shWrites);
+	p=write32(p,shSkips);
+
+	potmux_getStats(&potConversions,&potRounds,&potPeak);
+	p=write32(p,potConversions);
+	p=write32(p,potRounds);
+
+	midi_getSendStats(&sendHighWater,&sendOverflows);
+	p=write16(p,sendHighWater);
+	p=write16(p,sendOverflows);
+
+	storage_getCacheStats(&cacheHits,&cacheMisses,&cacheFlushes);
+	storage_getWriteQueue(&storagePending,&storageOldest,&storageWrites);
+	p=write32(p,cacheHits);
+	p=write32(p,cacheMisses);
+	p=write32(p,storageWrites);
+	p=write32(p,cacheFlushes);
+	p=write16(p,storagePending);
+	p=write16(p,storageOldest);
+
+	return p-buf;
+}
@@ -0,0 +1,47 @@
+#ifndef PROFILER_H
+#define	PROFILER_H
+
+#include "synth.h"
+
+// sections of synth_timerInterrupt, in execution order
+typedef enum
+{
+	prsLFO=0,		// LFO and modulation routing
+	prsVoices=1,	// refreshVoice x SYNTH_VOICE_COUNT
+	prsBitInputs=2,	// footswitch / tape in, MIDI clock
+	prsMIDI=3,		// phase 0: MIDI processing
+	prsClock=4,		// phase 1: clock, seq, arp, glide
+	prsVibrato=5,	// phase 2: vibrato, PWM
+	prsScanner=6,	// phase 3: scanner, display, ui
+	prsTotal=7,		// whole interrupt
+
+	// /!\ this must stay last
+	prsCount
+} profilerSection_t;
+
+struct profilerStats_s
+{
+	uint16_t min,max;
+	uint32_t sum;
+	uint16_t count;
+};
+
+void profiler_reset(void);
+
+#ifdef PROFILER
+void profiler_start(void);
+void profiler_lap(profilerSection_t section);
+void profiler_end(void);
+#else
+#define profiler_start()
+#define profiler_lap(section)
+#define profiler_end()
+#endif
+
+uint16_t profiler_getAverage(profilerSection_t section);
+const struct profilerStats_s * profiler_getStats(profilerSection_t section);
+uint16_t profiler_getOverruns(void);
+
+int16_t profiler_dump(uint8_t * buf); // returns size
+
+#endif	/* PROFILER_H */
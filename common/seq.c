@@ -129,11 +129,7 @@ inline void seq_setMode(int8_t track, seqMode_t mode)
 
 	if(oldMode==smOff)
 	{
-		// load sequence from storage on start
-		if(!storage_loadSequencer(track,tp->events,SEQ_NOTE_MEMORY))
-			memset(tp->events,ASSIGNER_NO_NOTE,SEQ_NOTE_MEMORY);
-
-		// compute note and step count
+		// the sequence is in RAM since seq_load(), compute note and step count
 		tp->eventCount=0;
 		tp->stepCount=0;
 		while(tp->eventCount<SEQ_NOTE_MEMORY)
@@ -356,3 +352,14 @@ void seq_init(void)
 		memset(seq.tracks[track].events,ASSIGNER_NO_NOTE,SEQ_NOTE_MEMORY);
 	}		
 }
+
+// the recorded sequences, once and for all: they're saved on record end, so the RAM copy stays current,
+// and starting a track from the panel doesn't read the EEPROM
+void seq_load(void)
+{
+	int8_t track;
+
+	for(track=0;track<SEQ_TRACK_COUNT;++track)
+		if(!storage_loadSequencer(track,seq.tracks[track].events,SEQ_NOTE_MEMORY))
+			memset(seq.tracks[track].events,ASSIGNER_NO_NOTE,SEQ_NOTE_MEMORY);
+}
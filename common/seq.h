@@ -34,6 +34,7 @@ typedef enum
 
 
 void seq_init(void);
+void seq_load(void);
 void seq_update(void);
 
 void seq_setMode(int8_t track, seqMode_t mode);
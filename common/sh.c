@@ -7,13 +7,34 @@
 
 #define SH_CV_COUNT 32
 
+// an unchanged CV is still rewritten after that many currentTick, against S&H droop
+#define SH_REFRESH_TICKS 2
+
 static struct
 {
 	uint32_t immediateBits;
 	uint16_t cvs[SH_CV_COUNT];
 	uint8_t gateBits;
+
+	// last value written to each S&H, and when
+	uint16_t lastCVs[SH_CV_COUNT];
+	uint8_t lastTicks[SH_CV_COUNT];
+
+	uint32_t writes,skips;
 } sh;
 
+static FORCEINLINE int8_t isCached(p600CV_t cv, uint16_t value)
+{
+	return sh.lastCVs[cv]==value && (uint8_t)((uint8_t)currentTick-sh.lastTicks[cv])<SH_REFRESH_TICKS;
+}
+
+static FORCEINLINE void setCached(p600CV_t cv, uint16_t value)
+{
+	sh.lastCVs[cv]=value;
+	sh.lastTicks[cv]=currentTick;
+	++sh.writes;
+}
+
 static inline void updateGates(void)
 {
 	BLOCK_INT
@@ -31,6 +52,8 @@ static inline void updateCV(p600CV_t cv, uint16_t cvv)
 	
 	BLOCK_INT
 	{
+		setCached(cv,cvv);
+
 		dac_write(cvv);
 	
 		// prepare S&H
@@ -59,6 +82,15 @@ inline void sh_setCV(p600CV_t cv,uint16_t value, uint8_t flags)
 {
 	if(flags&SH_FLAG_IMMEDIATE)
 	{
+		if(isCached(cv,value))
+		{
+			BLOCK_INT
+			{
+				++sh.skips;
+			}
+			return;
+		}
+
 		updateCV(cv,value);
 	}
 	else
@@ -81,6 +113,14 @@ FORCEINLINE void sh_setCV_FastPath(p600CV_t cv,uint16_t value)
 {
 	uint8_t dmux1,dmux2;
 	
+	if(isCached(cv,value))
+	{
+		++sh.skips;
+		return;
+	}
+
+	setCached(cv,value);
+
 	dmux1=(cv&0x07)|0xf8;
 	dmux2=dmux1&~(0x08<<(cv>>3));
 	
@@ -128,7 +168,31 @@ inline void sh_setGate(p600Gate_t gate,int8_t on)
 
 void sh_init()
 {
+	uint8_t i;
+
 	memset(&sh,0,sizeof(sh));
+
+	// nothing is cached yet
+	for(i=0;i<SH_CV_COUNT;++i)
+		sh.lastTicks[i]=(uint8_t)currentTick-SH_REFRESH_TICKS;
+}
+
+void sh_getStats(uint32_t * writes, uint32_t * skips)
+{
+	BLOCK_INT
+	{
+		*writes=sh.writes;
+		*skips=sh.skips;
+	}
+}
+
+void sh_resetStats(void)
+{
+	BLOCK_INT
+	{
+		sh.writes=0;
+		sh.skips=0;
+	}
 }
 
 void sh_update()
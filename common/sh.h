@@ -15,7 +15,10 @@ void sh_setCV32Sat_FastPath(p600CV_t cv,int32_t value);
 void sh_setGate(p600Gate_t gate,int8_t on);
 
 void sh_init(void);
-void sh_update(void);
+void sh_update(void); // writes all CVs, even unchanged ones
+
+void sh_getStats(uint32_t * writes, uint32_t * skips);
+void sh_resetStats(void);
 
 #endif	/* SH_H */
 
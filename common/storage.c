@@ -9,9 +9,13 @@
 #include "math.h"
 #include "midi.h"
 #include "display.h"
+#include "assigner.h"
 
 // increment this each time the binary format is changed
-#define STORAGE_VERSION 8
+#define STORAGE_VERSION 9
+
+// from this version on, presets are bit packed records, two per page (see presetPack())
+#define PRESET_PACKED_VERSION 9
 
 #define STORAGE_MAGIC 0x006116a5
 
@@ -20,6 +24,23 @@
 
 #define STORAGE_MAX_SIZE (SETTINGS_PAGE_COUNT*STORAGE_PAGE_SIZE) // this is the buffer size, which must at least hold the settings data (see above)
 
+// the directory pages tell which presets are used, with their storage version & patch name hash,
+// one page per 100 presets
+#define DIRECTORY_PAGE ((STORAGE_SIZE/STORAGE_PAGE_SIZE)-2)
+#define DIRECTORY_SLOT_COUNT 100
+#define DIRECTORY_PAGE_COUNT (PRESET_COUNT/DIRECTORY_SLOT_COUNT)
+#define DIRECTORY_VALID_OFFSET 5 // after the magic & version
+#define DIRECTORY_VERSION_OFFSET (DIRECTORY_VALID_OFFSET+(DIRECTORY_SLOT_COUNT+7)/8)
+#define DIRECTORY_HASH_OFFSET (DIRECTORY_VERSION_OFFSET+DIRECTORY_SLOT_COUNT)
+
+#define STORAGE_CACHE_PAGES 2 // RAM is tight, each one is a whole page
+
+// dirty pages are committed oldest first, one at a time, once left alone for a while with no key down,
+// or once they waited too long (ticks are ~2ms), explicit stores don't wait (see cache.flushing)
+#define STORAGE_COMMIT_DEBOUNCE_TICKS 250
+#define STORAGE_COMMIT_MAX_DELAY_TICKS 2500
+#define STORAGE_COMMIT_INTERVAL_TICKS 100
+
 const uint8_t steppedParameterRange[spCount] =
 {
     /* Osc A Saw */ 2,
@@ -52,16 +73,269 @@ const uint8_t steppedParameterRange[spCount] =
 
 };
 
+// v9 packed widths: pots are 8 to 12 bits deep (see potBitDepth[]), parameters without a pot are set
+// with the 12 bits data pot, 0: not in presets
+static const PROGMEM uint8_t continuousParameterBits[cpCount]=
+{
+	/* Freq A */ 12,
+	/* Vol A */ 8,
+	/* PW A */ 10,
+	/* Freq B */ 12,
+	/* Vol B */ 8,
+	/* PW B */ 10,
+	/* Freq B Fine */ 12,
+	/* Cutoff */ 12,
+	/* Resonance */ 8,
+	/* Filter Env Amount */ 10,
+	/* Filter Release */ 8,
+	/* Filter Sustain */ 10,
+	/* Filter Decay */ 8,
+	/* Filter Attack */ 8,
+	/* Amp Release */ 8,
+	/* Amp Sustain */ 10,
+	/* Amp Decay */ 8,
+	/* Amp Attack */ 8,
+	/* Poly Mod Filter Env */ 10,
+	/* Poly Mod Osc B */ 10,
+	/* LFO Freq */ 10,
+	/* LFO Amount */ 12,
+	/* Glide */ 8,
+	/* Amp Velocity */ 12,
+	/* Filter Velocity */ 12,
+	/* Mod Delay */ 12,
+	/* Vibrato Freq */ 12,
+	/* Vibrato Amount */ 12,
+	/* Unison Detune */ 12,
+	/* Arp/Seq Clock */ 0, // a setting
+	/* External */ 12,
+	/* Spread */ 12,
+	/* Mix Vol A */ 0,
+	/* Glide Vol B */ 0,
+	/* Drive */ 0,
+};
+
+static const PROGMEM uint8_t steppedParameterBits[spCount]=
+{
+	/* Osc A Saw */ 1,
+	/* Osc A Triangle */ 1,
+	/* Osc A Square */ 1,
+	/* Osc B Saw */ 1,
+	/* Osc B Triangle */ 1,
+	/* Osc B Sqr */ 1,
+	/* Sync */ 1,
+	/* Poly Mod Oscillator A Destination */ 1,
+	/* Poly Mod Filter Destination */ 1,
+	/* LFO Shape */ 3,
+	/* (unused, LFO range slot) */ 0,
+	/* LFO Targets */ 6,
+	/* Keyboard Filter Tracking */ 2,
+	/* Filter Envelope Shape */ 1,
+	/* Filter Envelope Fast/Slow */ 1,
+	/* 2nd Envelope Shape */ 1,
+	/* (hold pedal, a copy of 2nd Envelope Fast/Slow) */ 0,
+	/* Unison */ 1,
+	/* Assigner Priority Mode */ 2,
+	/* Pitch bender semitones */ 4,
+	/* Pitch bender target */ 3,
+	/* Modulation wheel range */ 2,
+	/* Osc pitch mode */ 3,
+	/* Modulation wheel target */ 1,
+	/* Vibrato target */ 2,
+	/* 2nd Envelope Fast/Slow */ 1,
+	/* PW Sync Bug */ 1,
+	/* Voice Assigner */ 1,
+	/* Envelope Routing */ 2,
+	/* LFO Sync */ 4,
+};
+
 struct settings_s settings;
 struct preset_s currentPreset;
 
 static struct
 {
-	uint8_t buffer[STORAGE_MAX_SIZE];
+	union
+	{
+		uint8_t buffer[STORAGE_MAX_SIZE];
+		struct
+		{
+			uint8_t page[STORAGE_PAGE_SIZE];
+			struct preset_s preset; // decoding room for imports, directory rebuilds & asynchronous loads, past the page they read
+		} scratch;
+	};
 	uint8_t * bufPtr;
+	uint8_t bitPos; // in *bufPtr, for bit packed data
 	uint8_t version;
+	volatile int8_t busy; // the main loop is using the storage with interrupts on
 } storage;
 
+// RAM copy of the directory validity bitmap
+static struct
+{
+	uint8_t valid[(PRESET_COUNT+7)/8];
+	int8_t loaded;
+} directory;
+
+typedef enum {plIdle=0,plRequested=1,plReady=2} presetLoadState_t;
+
+// asynchronous preset load: read & decoded into storage.scratch.preset by the main loop, swapped in by the timer interrupt
+static struct
+{
+	volatile uint8_t state;
+	uint16_t number;
+	uint8_t version;
+	uint8_t keep[(cpCount+spCount+7)/8]; // parameters changed by MIDI since the request
+} presetLoad;
+
+// write-back LRU cache in front of the EEPROM, one page over I2C is ~20ms to read, ~50ms to write
+// its dirty pages are the write queue, see storage_update()
+static struct
+{
+	uint8_t data[STORAGE_CACHE_PAGES][STORAGE_PAGE_SIZE];
+	uint16_t pageIdx[STORAGE_CACHE_PAGES];
+	uint8_t age[STORAGE_CACHE_PAGES]; // 0 is the most recently used
+	uint8_t valid,dirty; // bit per cache page
+	uint8_t seq[STORAGE_CACHE_PAGES],nextSeq; // order in which pages became dirty
+	uint32_t dirtyTick[STORAGE_CACHE_PAGES],writeTick[STORAGE_CACHE_PAGES];
+	uint32_t commitTick;
+	int8_t flushing; // a preset or a sequence was stored, everything queued is committed without waiting for a pause
+	uint32_t hits,misses,writes,flushes;
+} cache;
+
+static void cacheTouch(int8_t slot)
+{
+	int8_t i;
+
+	for(i=0;i<STORAGE_CACHE_PAGES;++i)
+		if(i!=slot && cache.age[i]<=cache.age[slot])
+			++cache.age[i];
+
+	cache.age[slot]=0;
+}
+
+static int8_t cacheFind(uint16_t pageIdx)
+{
+	int8_t i;
+
+	for(i=0;i<STORAGE_CACHE_PAGES;++i)
+		if((cache.valid&(1<<i)) && cache.pageIdx[i]==pageIdx)
+			return i;
+
+	return -1;
+}
+
+static void cacheWriteBack(int8_t slot)
+{
+	if(!(cache.dirty&(1<<slot)))
+		return;
+
+	storage_write(cache.pageIdx[slot],cache.data[slot]);
+	cache.dirty&=~(1<<slot);
+	++cache.flushes;
+}
+
+// head of the write queue, -1 if it's empty
+static int8_t cacheOldestDirty(void)
+{
+	int8_t i,slot=-1;
+
+	for(i=0;i<STORAGE_CACHE_PAGES;++i)
+		if((cache.dirty&(1<<i)) && (slot<0 || (uint8_t)(cache.nextSeq-cache.seq[i])>(uint8_t)(cache.nextSeq-cache.seq[slot])))
+			slot=i;
+
+	return slot;
+}
+
+// an empty page or the least recently used clean one, -1 if they all wait to be written
+static int8_t cacheFree(void)
+{
+	int8_t i,slot=-1;
+
+	for(i=0;i<STORAGE_CACHE_PAGES;++i)
+		if(!(cache.dirty&(1<<i)) && (slot<0 || !(cache.valid&(1<<i)) || ((cache.valid&(1<<slot)) && cache.age[i]>cache.age[slot])))
+			slot=i;
+
+	return slot;
+}
+
+static void cacheClaim(int8_t slot, uint16_t pageIdx)
+{
+	cache.pageIdx[slot]=pageIdx;
+	cache.valid|=1<<slot;
+}
+
+static void storageReadPage(uint16_t pageIdx, uint8_t * buf)
+{
+	int8_t slot;
+
+	slot=cacheFind(pageIdx);
+
+	if(slot>=0)
+	{
+		++cache.hits;
+	}
+	else
+	{
+		++cache.misses;
+		slot=cacheFree();
+
+		// queued pages aren't written back early for a read, it's just not cached
+		if(slot<0)
+		{
+			storage_read(pageIdx,buf);
+			return;
+		}
+
+		cacheClaim(slot,pageIdx);
+		storage_read(pageIdx,cache.data[slot]);
+	}
+
+	cacheTouch(slot);
+	memcpy(buf,cache.data[slot],STORAGE_PAGE_SIZE);
+}
+
+static void storageWritePage(uint16_t pageIdx, uint8_t * buf)
+{
+	int8_t slot;
+
+	slot=cacheFind(pageIdx);
+
+	if(slot<0)
+	{
+		slot=cacheFree();
+
+		// the queue is full, its oldest page goes first, so that pages reach the EEPROM in order
+		if(slot<0)
+		{
+			slot=cacheOldestDirty();
+			cacheWriteBack(slot);
+		}
+
+		cacheClaim(slot,pageIdx);
+	}
+	else if(!memcmp(cache.data[slot],buf,STORAGE_PAGE_SIZE))
+	{
+		buf=NULL; // same data, spare the EEPROM
+	}
+
+	cacheTouch(slot);
+
+	if(buf)
+	{
+		memcpy(cache.data[slot],buf,STORAGE_PAGE_SIZE);
+
+		// a page that's already queued keeps its place
+		if(!(cache.dirty&(1<<slot)))
+		{
+			cache.dirty|=1<<slot;
+			cache.seq[slot]=cache.nextSeq++;
+			cache.dirtyTick[slot]=currentTick;
+		}
+
+		cache.writeTick[slot]=currentTick;
+		++cache.writes;
+	}
+}
+
 static uint32_t storageRead32(void)
 {
 	uint32_t v;
@@ -136,6 +410,43 @@ static void storageWriteS8(int8_t v)
 	storage.bufPtr+=sizeof(v);
 }
 
+// LSB first, the data must be zeroed beforehand
+static void storageWriteBits(uint16_t v, uint8_t bits)
+{
+	while(bits--)
+	{
+		if(v&1)
+			*storage.bufPtr|=1<<storage.bitPos;
+		v>>=1;
+
+		if(++storage.bitPos==8)
+		{
+			storage.bitPos=0;
+			++storage.bufPtr;
+		}
+	}
+}
+
+static uint16_t storageReadBits(uint8_t bits)
+{
+	uint8_t i;
+	uint16_t v=0;
+
+	for(i=0;i<bits;++i)
+	{
+		if(*storage.bufPtr&(1<<storage.bitPos))
+			v|=1<<i;
+
+		if(++storage.bitPos==8)
+		{
+			storage.bitPos=0;
+			++storage.bufPtr;
+		}
+	}
+
+	return v;
+}
+
 static void resetPickUps(void)
 {
     uint8_t cnt;
@@ -147,7 +458,7 @@ static LOWERCODESIZE int8_t storageLoad(uint16_t pageIdx, uint8_t pageCount)
 	uint16_t i;
 	
 	for (i=0;i<pageCount;++i)
-		storage_read(pageIdx+i,&storage.buffer[STORAGE_PAGE_SIZE*i]);
+		storageReadPage(pageIdx+i,&storage.buffer[STORAGE_PAGE_SIZE*i]);
 	
 	storage.bufPtr=storage.buffer;
 	storage.version=0;
@@ -191,7 +502,7 @@ static LOWERCODESIZE void storageFinishStore(uint16_t pageIdx, uint8_t pageCount
 	uint16_t i;
 	
 	for (i=0;i<pageCount;++i)
-		storage_write(pageIdx+i,&storage.buffer[STORAGE_PAGE_SIZE*i]);
+		storageWritePage(pageIdx+i,&storage.buffer[STORAGE_PAGE_SIZE*i]);
 }
 
 LOWERCODESIZE int8_t settings_load(void)
@@ -230,7 +541,7 @@ LOWERCODESIZE int8_t settings_load(void)
 
 		settings.presetNumber=storageRead16();
 		// ensure that preset channel is valid, default to 0:
-		if (settings.presetNumber>99) settings.presetNumber=0;
+		if (settings.presetNumber>=PRESET_COUNT) settings.presetNumber=0;
 	    settings.benderMiddle=storageRead16();
 		settings.presetMode=storageRead8();
 		// ensure that MIDI channel is valid to void array out of bounds problems:
@@ -347,240 +658,638 @@ LOWERCODESIZE void settings_save(void)
 }
 
 
-LOWERCODESIZE int8_t preset_checkPage(uint16_t number)
+static uint8_t directoryNameHash(const uint8_t * name)
 {
-	BLOCK_INT
+	uint8_t i,h=0;
+
+	for(i=0;i<16;++i)
+		h=((h<<1)|(h>>7))^name[i];
+
+	return h;
+}
+
+// presets n & n+PRESET_PAGE_COUNT share page n, other pages (manual preset) hold a single one
+static uint16_t presetPage(uint16_t number)
+{
+	return (number<PRESET_COUNT)?number%PRESET_PAGE_COUNT:number;
+}
+
+static uint8_t * presetRecord(uint16_t number)
+{
+	return &storage.buffer[(number<PRESET_COUNT)?(number/PRESET_PAGE_COUNT)*PRESET_RECORD_SIZE:0];
+}
+
+// pages from before v9 hold a single preset, in the whole page
+static int8_t presetIsSinglePage(void)
+{
+	return *(uint32_t*)storage.buffer==STORAGE_MAGIC && storage.buffer[4]<PRESET_PACKED_VERSION;
+}
+
+// reads the page of a preset, the buffer points after its header
+static LOWERCODESIZE int8_t presetLocate(uint16_t number)
+{
+	uint8_t * record=presetRecord(number);
+
+	storageReadPage(presetPage(number),storage.buffer);
+	storage.bufPtr=record;
+	storage.version=0;
+
+	// the other half of a single preset page is part of it
+	if((record!=storage.buffer && presetIsSinglePage()) || storageRead32()!=STORAGE_MAGIC)
+	{
+		memset(storage.buffer,0,STORAGE_PAGE_SIZE);
+		return 0;
+	}
+
+	storage.version=storageRead8();
+
+	return 1;
+}
+
+// v9: parameters at their bit width (rounded, full scale stays full scale), the rest as is (see syxmgmt/storage_9.spec)
+static LOWERCODESIZE void presetPack(const struct preset_s * p)
+{
+	uint8_t i,bits;
+#ifdef DEBUG
+	uint8_t * record=storage.bufPtr;
+#endif
+
+	storageWrite32(STORAGE_MAGIC);
+	storageWrite8(PRESET_PACKED_VERSION);
+	storage.bitPos=0;
+
+	for(i=0;i<cpCount;++i)
+	{
+		bits=pgm_read_byte(&continuousParameterBits[i]);
+		if(bits)
+			storageWriteBits(MIN(((uint32_t)p->continuousParameters[i]+(1<<(15-bits)))>>(16-bits),(1<<bits)-1),bits);
+	}
+
+	for(i=0;i<spCount;++i)
+		storageWriteBits(p->steppedParameters[i],pgm_read_byte(&steppedParameterBits[i]));
+
+	for(i=0;i<SYNTH_VOICE_COUNT;++i)
+		storageWriteBits(p->voicePattern[i],8);
+
+	for(i=0;i<TUNER_NOTE_COUNT;++i)
+		storageWriteBits(p->perNoteTuning[i],16);
+
+	for(i=0;i<16;++i)
+		storageWriteBits(p->patchName[i],8);
+
+#ifdef DEBUG
+	if(storage.bufPtr-record>=PRESET_RECORD_SIZE)
+		print("Error: preset record too large !\n");
+#endif
+}
+
+static LOWERCODESIZE void presetUnpack(struct preset_s * p, int8_t withTuning)
+{
+	uint8_t i,bits;
+	uint16_t v;
+
+	storage.bitPos=0;
+
+	for(i=0;i<cpCount;++i)
 	{
-		if(!storageLoad(number,1))
+		bits=pgm_read_byte(&continuousParameterBits[i]);
+		if(bits)
 		{
-			return 0;
+			v=storageReadBits(bits);
+			p->continuousParameters[i]=(v==(1<<bits)-1)?UINT16_MAX:v<<(16-bits);
 		}
 	}
+
+	for(i=0;i<spCount;++i)
+	{
+		bits=pgm_read_byte(&steppedParameterBits[i]);
+		if(bits)
+			p->steppedParameters[i]=storageReadBits(bits);
+	}
+
+	p->steppedParameters[holdPedal]=p->steppedParameters[spAmpEnvSlow];
+	p->steppedParameters[spLFOSync]=(p->steppedParameters[spLFOSync]>7)?0:p->steppedParameters[spLFOSync];
+
+	for(i=0;i<SYNTH_VOICE_COUNT;++i)
+		p->voicePattern[i]=storageReadBits(8);
+
+	for(i=0;i<TUNER_NOTE_COUNT;++i)
+	{
+		v=storageReadBits(16);
+		if(withTuning)
+			p->perNoteTuning[i]=v;
+	}
+
+	for(i=0;i<16;++i)
+		p->patchName[i]=storageReadBits(8);
+}
+
+static LOWERCODESIZE void presetDefault(struct preset_s * p, int8_t makeSound);
+static LOWERCODESIZE int8_t presetDecode(struct preset_s * p, uint16_t number, uint8_t loadFromBuffer);
+
+// the page of a preset in the buffer, its record emptied & pointed at, the other preset of the page
+// stays; 0 if that one is an older single preset: it's left as it is, packing it would quantize it
+static LOWERCODESIZE int8_t presetPrepareStore(uint16_t number)
+{
+	uint8_t * record=presetRecord(number);
+
+	storageReadPage(presetPage(number),storage.buffer);
+
+	if(presetIsSinglePage())
+	{
+		if(record!=storage.buffer)
+			return 0;
+
+		memset(storage.buffer,0,STORAGE_PAGE_SIZE);
+	}
+
+	memset(record,0,PRESET_RECORD_SIZE);
+	storage.bufPtr=record;
+
 	return 1;
 }
 
-LOWERCODESIZE int8_t preset_loadCurrent(uint16_t number, uint8_t loadFromBuffer)
+static int8_t directoryIsValid(uint16_t number)
+{
+	return (directory.valid[number>>3]>>(number&7))&1;
+}
+
+// a directory page in the buffer, 0 if it's missing
+static LOWERCODESIZE int8_t directoryRead(uint8_t dirPage)
+{
+	storageReadPage(DIRECTORY_PAGE+dirPage,storage.buffer);
+	return *(uint32_t*)storage.buffer==STORAGE_MAGIC;
+}
+
+// a directory page from the buffer, with its part of the RAM bitmap
+static LOWERCODESIZE void directoryStore(uint8_t dirPage)
 {
 	uint8_t i;
-	int8_t readVar;
-	int16_t readVarLong;
-	
-	BLOCK_INT
+	uint16_t number;
+
+	*(uint32_t*)storage.buffer=STORAGE_MAGIC;
+	storage.buffer[4]=STORAGE_VERSION;
+	memset(&storage.buffer[DIRECTORY_VALID_OFFSET],0,DIRECTORY_VERSION_OFFSET-DIRECTORY_VALID_OFFSET);
+
+	for(i=0;i<DIRECTORY_SLOT_COUNT;++i)
 	{
+		number=dirPage*DIRECTORY_SLOT_COUNT+i;
+		if(directoryIsValid(number))
+			storage.buffer[DIRECTORY_VALID_OFFSET+(i>>3)]|=1<<(i&7);
+	}
 
-		// defaults
-		preset_loadDefault(0);
+	storageWritePage(DIRECTORY_PAGE+dirPage,storage.buffer);
+}
 
-        if (!loadFromBuffer)
-        {
-            if(!storageLoad(number,1))
-                return 0;
-        }
-        else
-        {
-            // check the storage MAGIC
-            storage.bufPtr=storage.buffer;
+static LOWERCODESIZE void directoryLoad(uint8_t dirPage)
+{
+	uint8_t i;
+	uint16_t number;
 
-            if(storageRead32()!=STORAGE_MAGIC)
-            {
-                memset(storage.buffer,0,sizeof(storage.buffer));
-                return 0;
-            }
-            storage.version=storageRead8();
-            resetPickUps();
-        }
+	for(i=0;i<DIRECTORY_SLOT_COUNT;++i)
+	{
+		number=dirPage*DIRECTORY_SLOT_COUNT+i;
+		directory.valid[number>>3]&=~(1<<(number&7));
+		if(storage.buffer[DIRECTORY_VALID_OFFSET+(i>>3)]&(1<<(i&7)))
+			directory.valid[number>>3]|=1<<(number&7);
+	}
+}
 
-        // compatibility with previous versions require the ""Pulse Width Sync Bug""
-        // --> for loading from old storage versions also override the default patch value "off"""
-        currentPreset.steppedParameters[spPWMBug]=1; // == bug "on"" for compatibility
+// reads every preset of the directory page, only once, when it's missing; preset pages come in the buffer,
+// the directory page is filled in the cache, where it waits to be written
+static LOWERCODESIZE void directoryRebuild(uint8_t dirPage)
+{
+	uint8_t i,version,nameHash;
+	uint16_t number;
 
-		for(i=0;i<SYNTH_VOICE_COUNT;++i)
-			currentPreset.voicePattern[i]=(i==0)?0:ASSIGNER_NO_NOTE;
-		
-		if (storage.version<1)
-			return 1;
+	for(i=0;i<DIRECTORY_SLOT_COUNT;++i)
+	{
+		number=dirPage*DIRECTORY_SLOT_COUNT+i;
+		directory.valid[number>>3]&=~(1<<(number&7));
+	}
 
-		// v1
-		
-		continuousParameter_t cp;
-		for(cp=cpFreqA;cp<=cpFilVelocity;++cp)
-			currentPreset.continuousParameters[cp]=storageRead16();
+	memset(storage.buffer,0,STORAGE_PAGE_SIZE);
+	directoryStore(dirPage);
 
-		steppedParameter_t sp;
-		for(sp=spASaw;sp<=spLFOShape;++sp)
-			currentPreset.steppedParameters[sp]=storageRead8();
+	for(i=0;i<DIRECTORY_SLOT_COUNT;++i)
+	{
+		number=dirPage*DIRECTORY_SLOT_COUNT+i;
 
-        readVar=storageRead8(); // this is legacy spLFOShift (see rescaling below, re-designated LFO Sync
-        if (storage.version<8)
-        {
-            // in this case readVar contains the legacy LFO speed range, where value 1 was "fast"
-            // rescale the LFO speed (the speed switch parameter was omitted from version 8 after)
-            // the exponential factor (ratio) was changed from 13000 to 8000
-            currentPreset.continuousParameters[cpLFOFreq]=(uint16_t)(0.615385f*(float)currentPreset.continuousParameters[cpLFOFreq])+25205;
-            // The slow LFO variant in version 7 / 2.1RC3 was made a factor of 8 slower comapred to the fast setting, so:
-            if (readVar==0) currentPreset.continuousParameters[cpLFOFreq]-=16635; // =0 used to be the slow setting
+		if(!presetDecode(&storage.scratch.preset,number,0))
+			continue;
 
-        }
+		version=storage.version;
+		nameHash=directoryNameHash(storage.scratch.preset.patchName); // older ones have no name, it's all zeroes
 
-		for(sp=spLFOTargets;sp<=spChromaticPitch;++sp)
-			currentPreset.steppedParameters[sp]=storageRead8();
+		directoryRead(dirPage);
+		directory.valid[number>>3]|=1<<(number&7);
+		storage.buffer[DIRECTORY_VERSION_OFFSET+i]=version;
+		storage.buffer[DIRECTORY_HASH_OFFSET+i]=nameHash;
+		directoryStore(dirPage);
+	}
+}
 
-		// remap of the sp values prior to version 8
-        if (storage.version<8)
-        {
-            // rescale the LFO amount as of version 8
-            // this is the inverse of the scaling functions applied to the LFO and vib amounts to make it smoother (small difference to stay within uint16_t here)
-            currentPreset.continuousParameters[cpLFOAmt]=(currentPreset.continuousParameters[cpLFOAmt]<=512)?0:(512+(uint16_t)(15000.0f*log((((float)(currentPreset.continuousParameters[cpLFOAmt]-512))/870.0f)+1)));
+// to be kept up to date with each preset write, the buffer is overwritten
+static LOWERCODESIZE void directoryUpdate(uint16_t number, uint8_t version, uint8_t nameHash)
+{
+	uint8_t dirPage,i;
 
-            // remap the exponential release and decay times after the phase lookup was updated (made longer mapping theorectial 285 to new 256)
-            if (currentPreset.steppedParameters[spAmpEnvShape]==1) // exponential
-            {
-                currentPreset.continuousParameters[cpAmpRel]=(uint16_t)(currentPreset.continuousParameters[cpAmpRel]*0.895f);
-                currentPreset.continuousParameters[cpAmpDec]=(uint16_t)(currentPreset.continuousParameters[cpAmpDec]*0.895f);
-            }
-            currentPreset.continuousParameters[cpAmpAtt]=(uint16_t)(currentPreset.continuousParameters[cpAmpAtt]*0.895f);
-            if (currentPreset.steppedParameters[spFilEnvShape]==1) // exponential
-            {
-                currentPreset.continuousParameters[cpFilRel]=(uint16_t)(currentPreset.continuousParameters[cpFilRel]*0.895f);
-                currentPreset.continuousParameters[cpFilDec]=(uint16_t)(currentPreset.continuousParameters[cpFilDec]*0.895f);
-            }
-            currentPreset.continuousParameters[cpFilAtt]=(uint16_t)(currentPreset.continuousParameters[cpFilAtt]*0.895f);
-        }
-		
-		currentPreset.steppedParameters[spAmpEnvSlow]=currentPreset.steppedParameters[holdPedal];
+	if(number>=PRESET_COUNT)
+		return;
 
-        // update mixer variables depending on panel layout
-        mixer_updatePanelLayout(settings.panelLayout);
+	if(!directory.loaded)
+		preset_loadDirectory();
 
-		if (storage.version<2)
-			return 1;
+	dirPage=number/DIRECTORY_SLOT_COUNT;
+	i=number%DIRECTORY_SLOT_COUNT;
 
-		// v2
+	directoryRead(dirPage);
 
-		for(cp=cpModDelay;cp<=cpSeqArpClock;++cp) // need to read out speed (last param, cpSeqArpClock) but not use, see below. speed is part of settings
-			currentPreset.continuousParameters[cp]=storageRead16();
+	// the page might not be cached, don't queue it for nothing
+	if(directoryIsValid(number) &&
+			storage.buffer[DIRECTORY_VERSION_OFFSET+i]==version &&
+			storage.buffer[DIRECTORY_HASH_OFFSET+i]==nameHash)
+		return;
 
-		currentPreset.continuousParameters[cpSeqArpClock]=settings.seqArpClock; // display uses current preset param, so replicate it from settings
+	directory.valid[number>>3]|=1<<(number&7);
+	storage.buffer[DIRECTORY_VERSION_OFFSET+i]=version;
+	storage.buffer[DIRECTORY_HASH_OFFSET+i]=nameHash;
 
-		for(sp=spModwheelTarget;sp<=spVibTarget;++sp)
-			currentPreset.steppedParameters[sp]=storageRead8();
+	directoryStore(dirPage);
+}
 
-		for(i=0;i<SYNTH_VOICE_COUNT;++i)
-			currentPreset.voicePattern[i]=storageRead8();
+LOWERCODESIZE void preset_loadDirectory(void)
+{
+	uint8_t dirPage;
 
-        // remap of the sp values prior to version 8
-        if (storage.version<8)
-        {
-            // rescale the vib amount as of version 8
-            // this is the inverse of the scaling functions applied to the LFO and vib amounts to make it smoother (small difference to stay within uint16_t here)
-			if (currentPreset.continuousParameters[cpVibAmt]<=2048)
-			{
-				currentPreset.continuousParameters[cpVibAmt]=0;
-			}
+	BLOCK_INT
+	{
+		for(dirPage=0;dirPage<DIRECTORY_PAGE_COUNT;++dirPage)
+		{
+			if(directoryRead(dirPage))
+				directoryLoad(dirPage);
 			else
-			{
-				currentPreset.continuousParameters[cpVibAmt]=(uint16_t)(15000.0f*log((((float)(currentPreset.continuousParameters[cpVibAmt]-2048))/3480.0f)+1))+512;
-			}
-            // rescale the vib frequency; the exponential factor (ratio) was changed from 13000 to 8000.
-            currentPreset.continuousParameters[cpVibFreq]=(uint16_t)(0.615385f*(float)currentPreset.continuousParameters[cpVibFreq])+25205;
+				directoryRebuild(dirPage);
+		}
+
+		directory.loaded=1;
+	}
+}
+
+LOWERCODESIZE int8_t preset_getDirectoryEntry(uint16_t number, uint8_t * version, uint8_t * nameHash)
+{
+	int8_t valid;
+
+	if(number>=PRESET_COUNT)
+		return 0;
+
+	BLOCK_INT
+	{
+		if(!directory.loaded)
+			preset_loadDirectory();
+
+		valid=directoryIsValid(number);
+
+		if(valid)
+		{
+			directoryRead(number/DIRECTORY_SLOT_COUNT);
+			*version=storage.buffer[DIRECTORY_VERSION_OFFSET+number%DIRECTORY_SLOT_COUNT];
+			*nameHash=storage.buffer[DIRECTORY_HASH_OFFSET+number%DIRECTORY_SLOT_COUNT];
+		}
+	}
+
+	return valid;
+}
+
+LOWERCODESIZE int8_t preset_checkPage(uint16_t number)
+{
+	// presets are in the directory, no need to read their page
+	if(number<PRESET_COUNT)
+	{
+		if(!directory.loaded)
+			preset_loadDirectory();
+
+		return directoryIsValid(number);
+	}
+
+	BLOCK_INT
+	{
+		if(!presetLocate(number))
+		{
+			return 0;
+		}
+	}
+	return 1;
+}
+
+
+// decodes a page, from the storage or already in the buffer, into p
+static LOWERCODESIZE int8_t presetDecode(struct preset_s * p, uint16_t number, uint8_t loadFromBuffer)
+{
+	uint8_t i;
+	int8_t readVar;
+	int16_t readVarLong;
+
+	// defaults
+	presetDefault(p,0);
+
+    if (!loadFromBuffer)
+    {
+        if(!presetLocate(number))
+            return 0;
+    }
+    else
+    {
+        // check the storage MAGIC
+        storage.bufPtr=storage.buffer;
+
+        if(storageRead32()!=STORAGE_MAGIC)
+        {
+            memset(storage.buffer,0,STORAGE_PAGE_SIZE);
+            return 0;
         }
+        storage.version=storageRead8();
+    }
 
-		if (storage.version<7)
-			return 1;
+    if (storage.version>=PRESET_PACKED_VERSION)
+    {
+        presetUnpack(p,number!=MANUAL_PRESET_PAGE || loadFromBuffer); // always reset equal tempered tuning for manual mode: keep defaults
+        return 1;
+    }
 
-		// v7
-		
-        for (i=0; i<TUNER_NOTE_COUNT; i++)
+    // compatibility with previous versions require the ""Pulse Width Sync Bug""
+    // --> for loading from old storage versions also override the default patch value "off"""
+    p->steppedParameters[spPWMBug]=1; // == bug "on"" for compatibility
+
+	for(i=0;i<SYNTH_VOICE_COUNT;++i)
+		p->voicePattern[i]=(i==0)?0:ASSIGNER_NO_NOTE;
+	
+	if (storage.version<1)
+		return 1;
+
+	// v1
+	
+	continuousParameter_t cp;
+	for(cp=cpFreqA;cp<=cpFilVelocity;++cp)
+		p->continuousParameters[cp]=storageRead16();
+
+	steppedParameter_t sp;
+	for(sp=spASaw;sp<=spLFOShape;++sp)
+		p->steppedParameters[sp]=storageRead8();
+
+    readVar=storageRead8(); // this is legacy spLFOShift (see rescaling below, re-designated LFO Sync
+    if (storage.version<8)
+    {
+        // in this case readVar contains the legacy LFO speed range, where value 1 was "fast"
+        // rescale the LFO speed (the speed switch parameter was omitted from version 8 after)
+        // the exponential factor (ratio) was changed from 13000 to 8000
+        p->continuousParameters[cpLFOFreq]=(uint16_t)(0.615385f*(float)p->continuousParameters[cpLFOFreq])+25205;
+        // The slow LFO variant in version 7 / 2.1RC3 was made a factor of 8 slower comapred to the fast setting, so:
+        if (readVar==0) p->continuousParameters[cpLFOFreq]-=16635; // =0 used to be the slow setting
+
+    }
+
+	for(sp=spLFOTargets;sp<=spChromaticPitch;++sp)
+		p->steppedParameters[sp]=storageRead8();
+
+	// remap of the sp values prior to version 8
+    if (storage.version<8)
+    {
+        // rescale the LFO amount as of version 8
+        // this is the inverse of the scaling functions applied to the LFO and vib amounts to make it smoother (small difference to stay within uint16_t here)
+        p->continuousParameters[cpLFOAmt]=(p->continuousParameters[cpLFOAmt]<=512)?0:(512+(uint16_t)(15000.0f*log((((float)(p->continuousParameters[cpLFOAmt]-512))/870.0f)+1)));
+
+        // remap the exponential release and decay times after the phase lookup was updated (made longer mapping theorectial 285 to new 256)
+        if (p->steppedParameters[spAmpEnvShape]==1) // exponential
         {
-            readVarLong=storageRead16();
-            if (number!=MANUAL_PRESET_PAGE || loadFromBuffer) currentPreset.perNoteTuning[i]=readVarLong; // always reset equal tempered tuning for manual mode: keep defaults
+            p->continuousParameters[cpAmpRel]=(uint16_t)(p->continuousParameters[cpAmpRel]*0.895f);
+            p->continuousParameters[cpAmpDec]=(uint16_t)(p->continuousParameters[cpAmpDec]*0.895f);
         }
-			
-		if (storage.version<8)
+        p->continuousParameters[cpAmpAtt]=(uint16_t)(p->continuousParameters[cpAmpAtt]*0.895f);
+        if (p->steppedParameters[spFilEnvShape]==1) // exponential
         {
-			return 1;
+            p->continuousParameters[cpFilRel]=(uint16_t)(p->continuousParameters[cpFilRel]*0.895f);
+            p->continuousParameters[cpFilDec]=(uint16_t)(p->continuousParameters[cpFilDec]*0.895f);
         }
+        p->continuousParameters[cpFilAtt]=(uint16_t)(p->continuousParameters[cpFilAtt]*0.895f);
+    }
 	
-		// V8
+	p->steppedParameters[spAmpEnvSlow]=p->steppedParameters[holdPedal];
 
-		readVar=storageRead8();
-		if (readVar<=1) // only accept valid values, otherwise default stays
-			currentPreset.steppedParameters[spPWMBug]=readVar;
+	if (storage.version<2)
+		return 1;
 
-        currentPreset.continuousParameters[cpSpread]=storageRead16();
-        currentPreset.continuousParameters[cpExternal]=storageRead16();
+	// v2
 
-        readVar=storageRead8(); // this is legacy mod wheel strength re-designated LFO Sync
-        if (readVar<=3) currentPreset.steppedParameters[spEnvRouting]=readVar;
+	for(cp=cpModDelay;cp<=cpSeqArpClock;++cp) // need to read out speed (last param, cpSeqArpClock) but not use, see below. speed is part of settings
+		p->continuousParameters[cp]=storageRead16();
 
-        readVar=storageRead8();
-        currentPreset.steppedParameters[spAssign]=(readVar>1)?0:readVar;
+	p->continuousParameters[cpSeqArpClock]=settings.seqArpClock; // display uses current preset param, so replicate it from settings
 
-		readVar=storageRead8();
-		currentPreset.steppedParameters[spLFOSync]=(readVar>7)?0:readVar;
+	for(sp=spModwheelTarget;sp<=spVibTarget;++sp)
+		p->steppedParameters[sp]=storageRead8();
 
-        for (i=0;i < 16; i++)
-            currentPreset.patchName[i]=storageRead8();
+	for(i=0;i<SYNTH_VOICE_COUNT;++i)
+		p->voicePattern[i]=storageRead8();
 
-	}
+    // remap of the sp values prior to version 8
+    if (storage.version<8)
+    {
+        // rescale the vib amount as of version 8
+        // this is the inverse of the scaling functions applied to the LFO and vib amounts to make it smoother (small difference to stay within uint16_t here)
+		if (p->continuousParameters[cpVibAmt]<=2048)
+		{
+			p->continuousParameters[cpVibAmt]=0;
+		}
+		else
+		{
+			p->continuousParameters[cpVibAmt]=(uint16_t)(15000.0f*log((((float)(p->continuousParameters[cpVibAmt]-2048))/3480.0f)+1))+512;
+		}
+        // rescale the vib frequency; the exponential factor (ratio) was changed from 13000 to 8000.
+        p->continuousParameters[cpVibFreq]=(uint16_t)(0.615385f*(float)p->continuousParameters[cpVibFreq])+25205;
+    }
+
+	if (storage.version<7)
+		return 1;
+
+	// v7
 	
+    for (i=0; i<TUNER_NOTE_COUNT; i++)
+    {
+        readVarLong=storageRead16();
+        if (number!=MANUAL_PRESET_PAGE || loadFromBuffer) p->perNoteTuning[i]=readVarLong; // always reset equal tempered tuning for manual mode: keep defaults
+    }
+
+	if (storage.version<8)
+    {
+		return 1;
+    }
+
+	// V8
+
+	readVar=storageRead8();
+	if (readVar<=1) // only accept valid values, otherwise default stays
+		p->steppedParameters[spPWMBug]=readVar;
+
+    p->continuousParameters[cpSpread]=storageRead16();
+    p->continuousParameters[cpExternal]=storageRead16();
+
+    readVar=storageRead8(); // this is legacy mod wheel strength re-designated LFO Sync
+    if (readVar<=3) p->steppedParameters[spEnvRouting]=readVar;
+
+    readVar=storageRead8();
+    p->steppedParameters[spAssign]=(readVar>1)?0:readVar;
+
+	readVar=storageRead8();
+	p->steppedParameters[spLFOSync]=(readVar>7)?0:readVar;
+
+	for (i=0;i < 16; i++)
+		p->patchName[i]=storageRead8();
+
 	return 1;
 }
 
-LOWERCODESIZE void preset_saveCurrent(uint16_t number)
+// what has to follow a decode, once the preset is current
+static LOWERCODESIZE void presetDecoded(uint8_t version)
 {
-	uint8_t i;
-	
+	// update mixer variables depending on panel layout
+	if (version>=1)
+		mixer_updatePanelLayout(settings.panelLayout);
+}
+
+LOWERCODESIZE int8_t preset_loadCurrent(uint16_t number, uint8_t loadFromBuffer)
+{
+	int8_t loaded;
+
 	BLOCK_INT
 	{
-		storagePrepareStore();
+		presetLoad.state=plIdle; // this load is the latest, a pending one would undo it
 
-		// v1
+		loaded=presetDecode(&currentPreset,number,loadFromBuffer);
+		presetDecoded(loaded?storage.version:0);
+	}
 
-		continuousParameter_t cp;
-		for(cp=cpFreqA;cp<=cpFilVelocity;++cp)
-			storageWrite16(currentPreset.continuousParameters[cp]);
+	return loaded;
+}
 
-		currentPreset.steppedParameters[holdPedal]=currentPreset.steppedParameters[spAmpEnvSlow];
+// from the main loop, with interrupts on: the slow EEPROM read doesn't stall the voices
+LOWERCODESIZE void preset_loadUpdate(void)
+{
+	int8_t loaded;
+	uint16_t number;
 
-		steppedParameter_t sp;
-		for(sp=spASaw;sp<=spChromaticPitch;++sp)
-			storageWrite8(currentPreset.steppedParameters[sp]);
-		
-		// v2
-		
-		for(cp=cpModDelay;cp<cpSeqArpClock;++cp) // skip arp/seq clock
-			storageWrite16(currentPreset.continuousParameters[cp]);
+	BLOCK_INT
+	{
+		if(presetLoad.state!=plRequested)
+			return;
 
-        // to avoid confusion, write zero to the arp/seq clock slot
-        storageWrite16(0);
+		number=presetLoad.number;
 
-		for(sp=spModwheelTarget;sp<=spVibTarget;++sp)
-			storageWrite8(currentPreset.steppedParameters[sp]);
+		// the button handlers & some MIDI ones are the other storage users, they're held meanwhile (see synth_timerInterrupt())
+		storage.busy=1;
+	}
 
-		for(i=0;i<SYNTH_VOICE_COUNT;++i)
-			storageWrite8(currentPreset.voicePattern[i]);
+	loaded=presetDecode(&storage.scratch.preset,number,0);
+	presetLoad.version=storage.version;
 
+	BLOCK_INT
+	{
+		// a program change may have come meanwhile, it stays requested and is read next time
+		if(presetLoad.state==plRequested && presetLoad.number==number)
+			presetLoad.state=loaded?plReady:plIdle; // like a synchronous load, empty pages are ignored
 
-        for (i=0; i<TUNER_NOTE_COUNT; i++)
-			storageWrite16(currentPreset.perNoteTuning[i]);
-			
-		// v8
-		
-		storageWrite8(currentPreset.steppedParameters[spPWMBug]);
-		storageWrite16(currentPreset.continuousParameters[cpSpread]);
-		storageWrite16(currentPreset.continuousParameters[cpExternal]);
-        storageWrite8(currentPreset.steppedParameters[spEnvRouting]);
-        storageWrite8(currentPreset.steppedParameters[spAssign]);
-        storageWrite8(currentPreset.steppedParameters[spLFOSync]);
+		storage.busy=0;
+	}
+}
+
+// from the timer interrupt, between two ticks
+void preset_loadSwap(void)
+{
+	uint8_t i;
+
+	if(presetLoad.state!=plReady)
+		return;
+
+	// MIDI changes made since the request came after it, they stay
+
+	for(i=0;i<cpCount;++i)
+		if(presetLoad.keep[i>>3]&(1<<(i&7)))
+			storage.scratch.preset.continuousParameters[i]=currentPreset.continuousParameters[i];
 
-        for (i=0;i < 16; i++)
-            storageWrite8(currentPreset.patchName[i]);
+	for(i=0;i<spCount;++i)
+		if(presetLoad.keep[(cpCount+i)>>3]&(1<<((cpCount+i)&7)))
+			storage.scratch.preset.steppedParameters[i]=currentPreset.steppedParameters[i];
 
+	memcpy(&currentPreset,&storage.scratch.preset,sizeof(currentPreset));
+	currentPreset.continuousParameters[cpSeqArpClock]=settings.seqArpClock;
+	presetDecoded(presetLoad.version);
+
+	settings.presetNumber=presetLoad.number;
+	ui_setPresetModified(0);
+	ui.presetModified=0;
+	ui_setNoActivePot(1);
+	synth_refreshLater(rgAll);
+
+	presetLoad.state=plIdle;
+}
+
+void preset_loadLater(uint16_t number)
+{
+	BLOCK_INT
+	{
+		presetLoad.number=number;
+		presetLoad.state=plRequested;
+		memset(presetLoad.keep,0,sizeof(presetLoad.keep));
+	}
+}
+
+int16_t preset_getPendingLoad(void)
+{
+	int16_t number=-1;
+
+	BLOCK_INT
+	{
+		if(presetLoad.state!=plIdle)
+			number=presetLoad.number;
+	}
+
+	return number;
+}
+
+void preset_keepOnLoad(int8_t stepped, uint8_t param)
+{
+	uint8_t i=stepped?cpCount+param:param;
+
+	if(presetLoad.state!=plIdle)
+		presetLoad.keep[i>>3]|=1<<(i&7);
+}
+
+int8_t storage_isBusy(void)
+{
+	// a loaded preset waits in the scratch space for its tick, imports & settings would overwrite it
+	return storage.busy || presetLoad.state==plReady;
+}
+
+LOWERCODESIZE int8_t preset_saveCurrent(uint16_t number)
+{
+	BLOCK_INT
+	{
+		currentPreset.steppedParameters[holdPedal]=currentPreset.steppedParameters[spAmpEnvSlow];
+
+		if(!presetPrepareStore(number))
+			return 0;
+
+		presetPack(&currentPreset);
 
 		// this must stay last
-		storageFinishStore(number,1); // yes, one page is enough
+		storageFinishStore(presetPage(number),1);
+
+		directoryUpdate(number,PRESET_PACKED_VERSION,directoryNameHash(currentPreset.patchName));
+
+		cache.flushing=1;
 	}
+
+	return 1;
 }
 
 LOWERCODESIZE int8_t storage_loadSequencer(int8_t track, uint8_t * data, uint8_t size)
@@ -608,49 +1317,90 @@ LOWERCODESIZE void storage_saveSequencer(int8_t track, uint8_t * data, uint8_t s
 		
 		// this must stay last
 		storageFinishStore(SEQUENCER_START_PAGE+track,1);
+
+		cache.flushing=1;
 	}
 }
 
+// the preset record, or its whole page for an older one, without its trailing zeroes, 0 if there's none
+static LOWERCODESIZE int16_t presetExport(uint16_t number, uint8_t ** record)
+{
+	int16_t size=0;
+
+	if(presetLocate(number))
+		size=(storage.version<PRESET_PACKED_VERSION)?STORAGE_PAGE_SIZE:PRESET_RECORD_SIZE;
+	*record=presetRecord(number);
+
+	// don't export trailing zeroes		
+	
+	while(size>0 && (*record)[size-1]==0)
+		--size;
+
+	return size;
+}
+
 LOWERCODESIZE void storage_export(uint16_t number, uint8_t * buf, int16_t * loadedSize)
 {
     // this function can only export from storage, therefore a patch needs to be stored first before exporting
-    // the function loads from storage into the buf, truncates all unwanted data from the end and ads the number at the beginning
-	int16_t actualSize;
+    // the function loads from storage, truncates all unwanted data from the end and ads the number at the beginning
+	int16_t size;
+	uint8_t * record;
 
 	BLOCK_INT
 	{
-		storageLoad(number,1); // load one page at position of the patch number
+		size=presetExport(number,&record);
 
-		// don't export trailing zeroes		
-		
-		actualSize=STORAGE_PAGE_SIZE;
-		while(actualSize>0 && storage.buffer[actualSize-1]==0)
-			--actualSize;
-		
-		buf[0]=number;		
-		memcpy(&buf[1],storage.buffer,actualSize);
-		*loadedSize=actualSize+1;
+		buf[0]=number;
+		memcpy(&buf[1],record,size);
+		*loadedSize=size+1;
 	}
 }
 
+LOWERCODESIZE int16_t storage_exportBegin(uint16_t number, uint8_t ** record)
+{
+	// the page is read with interrupts on, like preset_loadUpdate() does, so the storage handlers wait until storage_exportEnd()
+
+	storage.busy=1;
+
+	return presetExport(number,record);
+}
+
+void storage_exportEnd(void)
+{
+	storage.busy=0;
+}
+
 LOWERCODESIZE void storage_import(uint16_t number, uint8_t * buf, int16_t size)
 {
+	struct preset_s * p=&storage.scratch.preset; // the import is in the page, the preset is stored from it
+
 	BLOCK_INT
 	{
-        memset(storage.buffer,0,sizeof(storage.buffer));
+		// the buffer is shared with the main loop & the other handlers, so the import only comes in it now
+		memset(storage.buffer,0,sizeof(storage.buffer));
 		memcpy(storage.buffer,buf,size);
+
         // here we distinguish between MIDI to storage an MIDI to controls
         if (ui.isInPatchManagement)
         {
-            //  check the STORAGE_MAGIC
-            storage.bufPtr=storage.buffer;
-            if(storageRead32()!=STORAGE_MAGIC)
+            //  check the STORAGE_MAGIC, any version is stored as v9
+            if(number>=PRESET_COUNT || !presetDecode(p,number,1))
             {
                 memset(storage.buffer,0,sizeof(storage.buffer));
                 return;
             }
-            storage.bufPtr=storage.buffer+size;
-            storageFinishStore(number,1);
+
+            if(!presetPrepareStore(number))
+            {
+                sevenSeg_scrollText("older preset in the way",1);
+                return;
+            }
+
+            presetPack(p);
+            storageFinishStore(presetPage(number),1);
+
+            directoryUpdate(number,PRESET_PACKED_VERSION,directoryNameHash(p->patchName));
+            cache.flushing=1;
             // update the current selected preset
             if (settings.presetMode && settings.presetNumber == number) refreshPresetMode();
         }
@@ -665,50 +1415,54 @@ LOWERCODESIZE void storage_import(uint16_t number, uint8_t * buf, int16_t size)
 
     ui.presetAwaitingNumber=-1;
     if (ui.isInPatchManagement) ui.digitInput=diStoreDecadeDigit;
-    sevenSeg_setNumber(number);
+    sevenSeg_setPresetNumber(number,0);
 }
 
-LOWERCODESIZE void preset_loadDefault(int8_t makeSound)
+static LOWERCODESIZE void presetDefault(struct preset_s * p, int8_t makeSound)
 {
 	uint8_t i;
     
+	memset(p,0,sizeof(struct preset_s));
+
+	p->continuousParameters[cpAPW]=HALF_RANGE;
+	p->continuousParameters[cpBPW]=HALF_RANGE;
+	p->continuousParameters[cpCutoff]=UINT16_MAX;
+	p->continuousParameters[cpPModFilEnv]=HALF_RANGE;
+	p->continuousParameters[cpFreqBFine]=HALF_RANGE;
+	p->continuousParameters[cpFilEnvAmt]=HALF_RANGE;
+	p->continuousParameters[cpFreqBFine]=HALF_RANGE;
+	p->continuousParameters[cpLFOFreq]=HALF_RANGE;
+	p->continuousParameters[cpAmpSus]=UINT16_MAX;
+	p->continuousParameters[cpAmpVelocity]=HALF_RANGE;
+	p->continuousParameters[cpVibFreq]=HALF_RANGE;
+	if (settings.panelLayout==1) p->continuousParameters[cpDrive]=HALF_RANGE;
+    if (settings.panelLayout==0) p->continuousParameters[cpMixVolA]=UINT16_MAX;
+
+	p->steppedParameters[spBenderSemitones]=5;
+	p->steppedParameters[spModWheelRange]=1;
+	p->steppedParameters[spBenderTarget]=modAB;
+	p->steppedParameters[spChromaticPitch]=2; // octave
+    p->continuousParameters[cpSeqArpClock]=settings.seqArpClock;
+
+	memset(p->voicePattern,ASSIGNER_NO_NOTE,sizeof(p->voicePattern));
+
+	// Default tuning is equal tempered
+	for (i=0; i<TUNER_NOTE_COUNT; i++)
+		p->perNoteTuning[i] = i * TUNING_UNITS_PER_SEMITONE;
+
+	if(makeSound)
+		p->steppedParameters[spASaw]=1;
+}
+
+LOWERCODESIZE void preset_loadDefault(int8_t makeSound)
+{
 	BLOCK_INT
 	{
-		memset(&currentPreset,0,sizeof(currentPreset));
-
-		currentPreset.continuousParameters[cpAPW]=HALF_RANGE;
-		currentPreset.continuousParameters[cpBPW]=HALF_RANGE;
-		currentPreset.continuousParameters[cpCutoff]=UINT16_MAX;
-		currentPreset.continuousParameters[cpPModFilEnv]=HALF_RANGE;
-		currentPreset.continuousParameters[cpFreqBFine]=HALF_RANGE;
-		currentPreset.continuousParameters[cpFilEnvAmt]=HALF_RANGE;
-		currentPreset.continuousParameters[cpFreqBFine]=HALF_RANGE;
-		currentPreset.continuousParameters[cpLFOFreq]=HALF_RANGE;
-		currentPreset.continuousParameters[cpAmpSus]=UINT16_MAX;
-		currentPreset.continuousParameters[cpAmpVelocity]=HALF_RANGE;
-		currentPreset.continuousParameters[cpVibFreq]=HALF_RANGE;
-		if (settings.panelLayout==1) currentPreset.continuousParameters[cpDrive]=HALF_RANGE;
-        if (settings.panelLayout==0) currentPreset.continuousParameters[cpMixVolA]=UINT16_MAX;
-
-		currentPreset.steppedParameters[spBenderSemitones]=5;
-		currentPreset.steppedParameters[spModWheelRange]=1;
-		currentPreset.steppedParameters[spBenderTarget]=modAB;
-		currentPreset.steppedParameters[spChromaticPitch]=2; // octave
-        currentPreset.continuousParameters[cpSeqArpClock]=settings.seqArpClock;
-
-		memset(currentPreset.voicePattern,ASSIGNER_NO_NOTE,sizeof(currentPreset.voicePattern));
-
-		// Default tuning is equal tempered
-		for (i=0; i<TUNER_NOTE_COUNT; i++)
-			currentPreset.perNoteTuning[i] = i * TUNING_UNITS_PER_SEMITONE;
-
-		if(makeSound)
-			currentPreset.steppedParameters[spASaw]=1;
+		presetDefault(&currentPreset,makeSound);
 
         storage.version=STORAGE_VERSION;
 
         resetPickUps();
-
     }
 }
 
@@ -727,3 +1481,96 @@ LOWERCODESIZE void settings_loadDefault(void)
 		tuner_init(); // use theoretical tuning
 	}
 }
+
+// from the main loop, the EEPROM is written with interrupts on, the storage handlers are held meanwhile
+LOWERCODESIZE void storage_update(void)
+{
+	int8_t slot=-1;
+	uint32_t tick;
+
+	if(!cache.dirty)
+		return;
+
+	BLOCK_INT
+	{
+		tick=currentTick;
+		slot=cacheOldestDirty();
+
+		// the pages before an explicit store go with it, so that they still reach the EEPROM in order
+		if(slot>=0 && tick-cache.commitTick>=STORAGE_COMMIT_INTERVAL_TICKS &&
+				(cache.flushing || tick-cache.dirtyTick[slot]>=STORAGE_COMMIT_MAX_DELAY_TICKS ||
+				(tick-cache.writeTick[slot]>=STORAGE_COMMIT_DEBOUNCE_TICKS && !assigner_getAnyPressed())))
+			storage.busy=1;
+		else
+			slot=-1;
+	}
+
+	if(slot<0)
+		return;
+
+	cacheWriteBack(slot);
+	cache.commitTick=currentTick;
+
+	BLOCK_INT
+	{
+		if(!cache.dirty)
+			cache.flushing=0;
+
+		storage.busy=0;
+	}
+}
+
+LOWERCODESIZE void storage_flush(void)
+{
+	int8_t slot;
+
+	if(!cache.dirty)
+		return;
+
+	storage.busy=1;
+
+	while((slot=cacheOldestDirty())>=0)
+		cacheWriteBack(slot);
+
+	cache.flushing=0;
+	storage.busy=0;
+}
+
+void storage_getCacheStats(uint32_t * hits, uint32_t * misses, uint32_t * flushes)
+{
+	BLOCK_INT
+	{
+		*hits=cache.hits;
+		*misses=cache.misses;
+		*flushes=cache.flushes;
+	}
+}
+
+void storage_getWriteQueue(uint8_t * pending, uint16_t * oldestAge, uint32_t * writes)
+{
+	int8_t i,slot;
+
+	BLOCK_INT
+	{
+		*pending=0;
+		for(i=0;i<STORAGE_CACHE_PAGES;++i)
+			if(cache.dirty&(1<<i))
+				++*pending;
+
+		slot=cacheOldestDirty();
+		*oldestAge=(slot<0)?0:MIN(currentTick-cache.dirtyTick[slot],UINT16_MAX);
+
+		*writes=cache.writes;
+	}
+}
+
+void storage_resetCacheStats(void)
+{
+	BLOCK_INT
+	{
+		cache.hits=0;
+		cache.misses=0;
+		cache.writes=0;
+		cache.flushes=0;
+	}
+}
@@ -8,6 +8,12 @@
 #define MANUAL_PRESET_PAGE ((STORAGE_SIZE/STORAGE_PAGE_SIZE)-5)
 #define SEQUENCER_START_PAGE 200
 
+// presets n & n+100 share page n (bit packed from storage version 9, see storage.c)
+#define PRESET_PAGE_COUNT 100
+#define PRESETS_PER_PAGE 2
+#define PRESET_RECORD_SIZE (STORAGE_PAGE_SIZE/PRESETS_PER_PAGE)
+#define PRESET_COUNT (PRESET_PAGE_COUNT*PRESETS_PER_PAGE)
+
 typedef enum
 {
 	cpFreqA=0,cpVolA=1,cpAPW=2,
@@ -118,18 +124,38 @@ int8_t settings_load(void);
 void settings_save(void);
 
 int8_t preset_checkPage(uint16_t number);
+void preset_loadDirectory(void); // rebuilt if missing, that reads every preset page
+int8_t preset_getDirectoryEntry(uint16_t number, uint8_t * version, uint8_t * nameHash); // 0 if the preset is empty
 int8_t preset_loadCurrent(uint16_t number, uint8_t loadFromBuffer);
-void preset_saveCurrent(uint16_t number);
+int8_t preset_saveCurrent(uint16_t number); // 0 if an older single preset has its page (see presetPrepareStore())
+
+// asynchronous load: read by the main loop, then swapped in at a tick, pending until then
+void preset_loadLater(uint16_t number);
+int16_t preset_getPendingLoad(void); // preset number, -1 if none
+void preset_keepOnLoad(int8_t stepped, uint8_t param); // a parameter change that must survive the pending load
+void preset_loadUpdate(void);
+void preset_loadSwap(void);
+int8_t storage_isBusy(void); // the button handlers & the MIDI ones that use the storage must wait
 
 void preset_loadDefault(int8_t makeSound);
 void settings_loadDefault(void);
 
 void storage_simpleExport(uint16_t number, uint8_t * buf, int16_t size);
 void storage_export(uint16_t number, uint8_t * buf, int16_t * loadedSize);
-void storage_import(uint16_t number, uint8_t * buf, int16_t size);
+int16_t storage_exportBegin(uint16_t number, uint8_t ** record); // main loop only, the record without its number stays valid until storage_exportEnd(), returns its size
+void storage_exportEnd(void);
+void storage_import(uint16_t number, uint8_t * buf, int16_t size); // size: STORAGE_PAGE_SIZE at most
 
 int8_t storage_loadSequencer(int8_t track, uint8_t * data, uint8_t size);
 void storage_saveSequencer(int8_t track, uint8_t * data, uint8_t size);
 
+// pages are written back from a RAM cache: storage_update() commits them in the background,
+// storage_flush() right away
+void storage_update(void);
+void storage_flush(void);
+void storage_getCacheStats(uint32_t * hits, uint32_t * misses, uint32_t * flushes);
+void storage_getWriteQueue(uint8_t * pending, uint16_t * oldestAge, uint32_t * writes); // writes: pages written to the cache
+void storage_resetCacheStats(void);
+
 #endif	/* STORAGE_H */
 
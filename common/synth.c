@@ -23,7 +23,9 @@
 #include "../xnormidi/midi.h"
 #include "seq.h"
 #include "clock.h"
+#include "extclock.h"
 #include "utils.h"
+#include "profiler.h"
 
 #define POT_DEAD_ZONE 512
 
@@ -36,6 +38,12 @@
 // The P600 VCA completely closes before the CV reaches 0, this accounts for it
 #define VCA_DEADBAND 771 // GliGli = 768
 
+// Idle voices (unassigned, both envelopes waiting) only get refreshed every 8th tick, against S&H droop
+#define IDLE_VOICE_REFRESH_MASK 0x07
+
+// MIDI realtime messages waiting for the timer interrupt, power of 2
+#define REALTIME_QUEUE_SIZE 16
+
 #define BIT_INTPUT_FOOTSWITCH 0x20
 #define BIT_INTPUT_TAPE_IN 0x01
 
@@ -72,6 +80,14 @@ const uint16_t extClockDividers[16] = {192,168,144,128,96,72,48,36,24,18,12,9,6,
 
 volatile uint32_t currentTick=0; // 500hz
 
+// modulation routing, compiled from the stepped parameters by refreshRoutingPlan()
+typedef enum
+{
+    rtVibA=1,rtVibB=2,rtLfoA=4,rtLfoB=8,rtLfoVCF=16,rtLfoVCA=32,rtPModFA=64
+} routingTarget_t;
+
+typedef void (*renderVoices_t)(uint8_t skipVoices,int16_t oscEnvAmt,int16_t filEnvAmt,int16_t pitchALfoVal,int16_t pitchBLfoVal,int16_t filterLfoVal,uint16_t ampLfoVal);
+
 struct synth_s
 {
     struct adsr_s filEnvs[SYNTH_VOICE_COUNT];
@@ -113,7 +129,13 @@ struct synth_s
     uint32_t modulationDelayStart;
     uint16_t modulationDelayTickCount;
 
-    uint8_t pendingExtClock;
+    uint8_t pendingExtClock; // tape sync
+
+    // MIDI realtime messages, queued by the UART interrupt, handled by the next timer interrupt
+    uint8_t realtimeEvents[REALTIME_QUEUE_SIZE];
+    uint16_t realtimeStamps[REALTIME_QUEUE_SIZE];
+    uint8_t realtimeHead,realtimeTail;
+    uint16_t timerTicks; // 2Khz
 
     int8_t transpose;
 
@@ -121,7 +143,16 @@ struct synth_s
 
     uint8_t freqDial;
 
-    // uint32_t updateCounter; // for performance measurement
+    uint8_t idleVoices; // bit per voice, see handleFinishedVoices()
+
+    uint8_t pendingRefresh; // refreshGroup_t bits, see synth_refreshLater()
+    uint32_t refreshRequests,refreshes;
+
+    struct
+    {
+        renderVoices_t renderVoices; // refreshVoice() specialized for spEnvRouting
+        uint8_t targets; // routingTarget_t bits
+    } routing;
 
 } synth;
 
@@ -200,6 +231,15 @@ static void computeTunedOffsetCVs(void) // this function must always be called a
 }
 
 
+// computeTunedCVs() change domains, only the base CVs of dirty domains are recomputed
+typedef enum
+{
+    tdOscA=1,   // osc A frequency, chromatic setting
+    tdOscB=2,   // osc B frequency, chromatic setting
+    tdFil=4,    // cutoff, tracking
+    tdTune=8,   // master tune, osc B fine, those don't touch the base CVs
+} tunedDomain_t;
+
 static void computeTunedCVs(int8_t force, int8_t forceVoice)
 {
 
@@ -217,6 +257,7 @@ static void computeTunedCVs(int8_t force, int8_t forceVoice)
     uint16_t cva,cvb,cvf;
     uint8_t note=SCANNER_BASE_NOTE,baseCutoffNote;
     int8_t v, v_aux;
+    uint8_t dirty,voiceDirty;
 
     uint16_t baseAPitch,baseBPitch,baseCutoff;
     int16_t mTune,fineBFreq,detune;
@@ -227,23 +268,26 @@ static void computeTunedCVs(int8_t force, int8_t forceVoice)
     int16_t sNote,baseANote,ANote,baseBNote,BNote,trackingNote;
 
     static uint16_t baseAPitchRaw,baseBPitchRaw,baseCutoffRaw,mTuneRaw,fineBFreqRaw,detuneRaw,spreadRaw;
-    static uint8_t track,chrom;
+    static uint8_t track,chrom,unison;
 
-    // detect change & quit if none
+    // detect changes, per domain, & quit if none
 
-    if(!force &&
-            mTuneRaw==potmux_getValue(ppMTune) &&
-            fineBFreqRaw==currentPreset.continuousParameters[cpFreqBFine] &&
-            baseCutoffRaw==currentPreset.continuousParameters[cpCutoff] &&
-            baseAPitchRaw==currentPreset.continuousParameters[cpFreqA] &&
-            baseBPitchRaw==currentPreset.continuousParameters[cpFreqB] &&
-            detuneRaw==currentPreset.continuousParameters[cpUnisonDetune] &&
-            track==currentPreset.steppedParameters[spTrackingShift] &&
-            chrom==currentPreset.steppedParameters[spChromaticPitch] &&
-            spreadRaw==currentPreset.continuousParameters[cpSpread])
-    {
+    dirty=0;
+
+    if(mTuneRaw!=potmux_getValue(ppMTune) || fineBFreqRaw!=currentPreset.continuousParameters[cpFreqBFine])
+        dirty|=tdTune;
+    if(baseAPitchRaw!=currentPreset.continuousParameters[cpFreqA] || chrom!=currentPreset.steppedParameters[spChromaticPitch])
+        dirty|=tdOscA;
+    if(baseBPitchRaw!=currentPreset.continuousParameters[cpFreqB] || chrom!=currentPreset.steppedParameters[spChromaticPitch])
+        dirty|=tdOscB;
+    if(baseCutoffRaw!=currentPreset.continuousParameters[cpCutoff] || track!=currentPreset.steppedParameters[spTrackingShift])
+        dirty|=tdFil;
+    if(detuneRaw!=currentPreset.continuousParameters[cpUnisonDetune] || spreadRaw!=currentPreset.continuousParameters[cpSpread] ||
+            unison!=currentPreset.steppedParameters[spUnison])
+        dirty|=tdOscA|tdOscB|tdFil;
+
+    if(!force && !dirty)
         return;
-    }
 
     mTuneRaw=potmux_getValue(ppMTune);
     fineBFreqRaw=currentPreset.continuousParameters[cpFreqBFine];
@@ -254,6 +298,7 @@ static void computeTunedCVs(int8_t force, int8_t forceVoice)
     track=currentPreset.steppedParameters[spTrackingShift];
     chrom=currentPreset.steppedParameters[spChromaticPitch];
     spreadRaw=currentPreset.continuousParameters[cpSpread];
+    unison=currentPreset.steppedParameters[spUnison];
 
     // compute for oscs & filters
 
@@ -312,9 +357,15 @@ static void computeTunedCVs(int8_t force, int8_t forceVoice)
         // to its preset value. In this case, use the default
         // value of SCANNER_BASE_NOTE for note (see declaration above),
         // as the assigner does not yet have a valid note for the voice.
-        if ((forceVoice>=0 && v!=forceVoice) || (!assigner_getAssignment(v,&note) && force!=-1))
+        // A voice that got a new note (forceVoice) needs all its terms,
+        // the others only the domains that changed since last time.
+        if ((forceVoice>=0 && v!=forceVoice && !dirty) || (!assigner_getAssignment(v,&note) && force!=-1))
             continue;
 
+        voiceDirty=dirty;
+        if(force && (forceVoice<0 || v==forceVoice))
+            voiceDirty=tdOscA|tdOscB|tdFil|tdTune;
+
         // Subtract bottom C, signed result. Here a value of 0
         // is lowest C on kbd, values below that can arrive via MIDI
         sNote=note-SCANNER_BASE_NOTE;
@@ -343,10 +394,16 @@ static void computeTunedCVs(int8_t force, int8_t forceVoice)
             }
         }
 
-        v_aux=v;
-        synth.oscABaseCV[v]=satAddU16S16(tuner_computeCVFromNote(ANote,baseAPitch,pcOsc1A+v),(1+(v_aux>>1))*(v_aux&1?-1:1)*detune);
-        v_aux=(v+3)%6;
-        synth.oscBBaseCV[v]=satAddU16S16(tuner_computeCVFromNote(BNote,baseBPitch,pcOsc1B+v),(1+(v_aux>>1))*(v_aux&1?-1:1)*detune);
+        if(voiceDirty&tdOscA)
+        {
+            v_aux=v;
+            synth.oscABaseCV[v]=satAddU16S16(tuner_computeCVFromNote(ANote,baseAPitch,pcOsc1A+v),(1+(v_aux>>1))*(v_aux&1?-1:1)*detune);
+        }
+        if(voiceDirty&tdOscB)
+        {
+            v_aux=(v+3)%6;
+            synth.oscBBaseCV[v]=satAddU16S16(tuner_computeCVFromNote(BNote,baseBPitch,pcOsc1B+v),(1+(v_aux>>1))*(v_aux&1?-1:1)*detune);
+        }
 
         // filter
 
@@ -364,21 +421,27 @@ static void computeTunedCVs(int8_t force, int8_t forceVoice)
                 trackingNote=0;
         }
 
-        v_aux=(v+5)%6;
-        synth.filterBaseCV[v]=satAddU16S16(tuner_computeCVFromNote(trackingNote,baseCutoff,pcFil1+v),(1+(v_aux>>1))*detune);
+        if(voiceDirty&tdFil)
+        {
+            v_aux=(v+5)%6;
+            synth.filterBaseCV[v]=satAddU16S16(tuner_computeCVFromNote(trackingNote,baseCutoff,pcFil1+v),(1+(v_aux>>1))*detune);
+        }
 
         // unison detune
 
-        if(currentPreset.steppedParameters[spUnison])
+        if(unison)
         {
             detune=(1+(v>>1))*(v&1?-1:1)*(detuneRaw>>8);
             // scale detune with tone, e.g. less pronounced at higher frequencies
-            synth.oscABaseCV[v]=satAddU16S16(synth.oscABaseCV[v],(int16_t)(detune*(1.0f-(2.0f*(float)synth.oscABaseCV[v])/131072.0f)));
-            synth.oscBBaseCV[v]=satAddU16S16(synth.oscBBaseCV[v],(int16_t)(detune*(1.0f-(2.0f*(float)synth.oscBBaseCV[v])/131072.0f)));
-            synth.filterBaseCV[v]=satAddU16S16(synth.filterBaseCV[v],(int16_t)(detune*(1.0f-(2.0f*(float)synth.filterBaseCV[v])/131072.0f)));
+            if(voiceDirty&tdOscA)
+                synth.oscABaseCV[v]=satAddU16S16(synth.oscABaseCV[v],scaleU16S16(UINT16_MAX-synth.oscABaseCV[v],detune));
+            if(voiceDirty&tdOscB)
+                synth.oscBBaseCV[v]=satAddU16S16(synth.oscBBaseCV[v],scaleU16S16(UINT16_MAX-synth.oscBBaseCV[v],detune));
+            if(voiceDirty&tdFil)
+                synth.filterBaseCV[v]=satAddU16S16(synth.filterBaseCV[v],scaleU16S16(UINT16_MAX-synth.filterBaseCV[v],detune));
         }
 
-        // bender and tune
+        // bender and tune (cheap, always done)
 
         cva=satAddU16S32(synth.oscABaseCV[v],(int32_t)synth.benderCVs[pcOsc1A+v]+mTune);
 
@@ -587,7 +650,7 @@ static void refreshModDelayLFORetrigger(int8_t refreshDelayTickCount)
     prevAnyPressed=anyPressed;
 
     if(refreshDelayTickCount)
-        synth.modulationDelayTickCount=exponentialCourse(UINT16_MAX-currentPreset.continuousParameters[cpModDelay],12000.0f,2500.0f);
+        synth.modulationDelayTickCount=exponentialCourse(UINT16_MAX-currentPreset.continuousParameters[cpModDelay],EXP_COEF(12000),2500);
 }
 
 static void handleFinishedVoices(void)
@@ -613,6 +676,11 @@ static void handleFinishedVoices(void)
                 adsr_reset(&synth.ampEnvs[v]);
                 adsr_reset(&synth.filEnvs[v]);
             }
+            else if (synth.filEnvs[v].stage==sWait)
+            {
+                // voice is silent, its amp CV is 0 already, reduce its refresh rate
+                synth.idleVoices|=1<<v;
+            }
         }
     }
 }
@@ -763,7 +831,7 @@ static void refreshLfoSettings(void)
 
     synth.lfoAmt=currentPreset.continuousParameters[cpLFOAmt];
     synth.lfoAmt=(synth.lfoAmt<POT_DEAD_ZONE)?0:(synth.lfoAmt-POT_DEAD_ZONE);
-    synth.lfoAmt=((expf(((float)synth.lfoAmt)/15000.0f )-1.0f)*870.0f);
+    synth.lfoAmt=exponentialRise(synth.lfoAmt,EXP_COEF(15000),870);
 
     lfo_setFreq(&synth.lfo,currentPreset.continuousParameters[cpLFOFreq]);
 
@@ -850,13 +918,13 @@ static void refreshSevenSeg(void) // imogen: this function would be more suited
         {
             led_set(plDot,0,0);
             if(ui.presetAwaitingNumber>=0)
-                sevenSeg_setAscii('0'+ui.presetAwaitingNumber,' ');
+                sevenSeg_setPresetNumber(ui.presetAwaitingNumber*10,1);
             else
                 if (!ui.isInPatchManagement) sevenSeg_setAscii(' ',' '); // keep the previous display (might be a MIDI load or dump message)
         }
         else
         {
-            sevenSeg_setNumber(settings.presetNumber);
+            sevenSeg_setPresetNumber(settings.presetNumber,0);
             led_set(plDot,ui.presetModified,0);
         }
     }
@@ -897,20 +965,70 @@ void refreshFilterMaxCV(void)
 }
 
 
+static void refreshRoutingPlan(void);
+
+static void refreshGroups(uint8_t groups)
+{
+    if(groups&rgRouting)
+        refreshRoutingPlan();
+    if(groups&rgModDelay)
+        refreshModDelayLFORetrigger(1);
+    if(groups&rgGates)
+        refreshGates();
+    if(groups&rgAssigner)
+        refreshAssignerSettings();
+    if(groups&rgLfo)
+    {
+        refreshLfoSettings();
+        ui.vibAmountChangePending=1;
+        ui.vibFreqChangePending=1;
+    }
+    if(groups&rgEnv)
+        refreshEnvSettings();
+    if(groups&rgPitch)
+    {
+        computeTunedOffsetCVs();
+        computeBenderCVs();
+        refreshFilterMaxCV();
+    }
+
+    if(groups&rgDisplay)
+        refreshSevenSeg();
+}
+
 void refreshFullState(void)
 {
-    refreshModDelayLFORetrigger(1);
-    refreshGates();
-    refreshAssignerSettings();
-    refreshLfoSettings();
-    ui.vibAmountChangePending=1;
-    ui.vibFreqChangePending=1;
-    refreshEnvSettings();
-    computeTunedOffsetCVs();
-    computeBenderCVs();
-    refreshFilterMaxCV();
+    refreshGroups(rgAll);
+}
+
+void synth_refreshLater(uint8_t groups)
+{
+    // parameter streams (eg. MIDI CC automation) can change a lot of parameters between two
+    // synth_update(), only mark what needs a refresh, synth_update() does it once for all of them
 
-    refreshSevenSeg();
+    BLOCK_INT
+    {
+        synth.pendingRefresh|=groups;
+        ++synth.refreshRequests;
+    }
+}
+
+void synth_getRefreshStats(uint32_t * requests, uint32_t * refreshes)
+{
+    BLOCK_INT
+    {
+        *requests=synth.refreshRequests;
+        *refreshes=synth.refreshes;
+    }
+}
+
+void synth_resetRefreshStats(void)
+{
+    BLOCK_INT
+    {
+        synth.refreshRequests=0;
+        synth.refreshes=0;
+    }
 }
 
 static void refreshPresetPots(int8_t force) // this only affects current preset parameters
@@ -925,6 +1043,7 @@ static void refreshPresetPots(int8_t force) // this only affects current preset
         {
             p600Pot_t pp=continuousParameterToPot[cp];
             uint16_t value=potmux_getValue(pp);
+            uint16_t prev=currentPreset.continuousParameters[cp];
 
             if(potmux_isPotZeroCentered(pp, settings.panelLayout))
             {
@@ -958,6 +1077,11 @@ static void refreshPresetPots(int8_t force) // this only affects current preset
                 }
             }
 
+            // panel moves to MIDI
+
+            if(!force && (prev^currentPreset.continuousParameters[cp])&0xfffc)
+                midi_sendContinuousParameter(cp,currentPreset.continuousParameters[cp],potmux_getBitDepth(pp));
+
         }
         if (cp==cpMixVolA || cp==cpGlideVolB)
         {
@@ -1075,12 +1199,15 @@ void refreshPresetMode(void)
 
 }
 
-static FORCEINLINE void refreshVoice(int8_t v,int16_t oscEnvAmt,int16_t filEnvAmt,int16_t pitchALfoVal,int16_t pitchBLfoVal,int16_t filterLfoVal,uint16_t ampLfoVal)
+static FORCEINLINE void refreshVoice(int8_t v,const int8_t envRouting,uint8_t skipVoices,int16_t oscEnvAmt,int16_t filEnvAmt,int16_t pitchALfoVal,int16_t pitchBLfoVal,int16_t filterLfoVal,uint16_t ampLfoVal)
 {
     int32_t va,vb,vf;
     uint16_t envVal;
     uint16_t ampEnvVal;
 
+    if(skipVoices&(1<<v))
+        return;
+
     BLOCK_INT
     {
         // update envs, compute CVs & apply them
@@ -1099,7 +1226,7 @@ static FORCEINLINE void refreshVoice(int8_t v,int16_t oscEnvAmt,int16_t filEnvAm
 
         // osc A
 
-        if (currentPreset.steppedParameters[spEnvRouting]==0) // the normal case
+        if (envRouting==0) // the normal case
             va=scaleU16S16(envVal,oscEnvAmt);
         else // all other cases
             va=scaleU16S16(ampEnvVal,oscEnvAmt);
@@ -1121,9 +1248,9 @@ static FORCEINLINE void refreshVoice(int8_t v,int16_t oscEnvAmt,int16_t filEnvAm
 
         // apply amplifier
 
-        if (currentPreset.steppedParameters[spEnvRouting]==2) // the poly case, e.g. amplitude via filter envelope
+        if (envRouting==2) // the poly case, e.g. amplitude via filter envelope
             va=scaleU16U16(envVal,ampLfoVal);
-        else if (currentPreset.steppedParameters[spEnvRouting]==3) // this is the gate case for amplitude
+        else if (envRouting==3) // this is the gate case for amplitude
         {
             va=0;
             if (adsr_getStage(&synth.ampEnvs[v])>=sAttack&&adsr_getStage(&synth.ampEnvs[v])<=sSustain)
@@ -1139,7 +1266,71 @@ static FORCEINLINE void refreshVoice(int8_t v,int16_t oscEnvAmt,int16_t filEnvAm
     }
 }
 
+// one voice loop per spEnvRouting value, so that the routing is resolved at compile time
+
+#define RENDER_VOICES(name,envRouting) \
+static NOINLINE void name(uint8_t skipVoices,int16_t oscEnvAmt,int16_t filEnvAmt,int16_t pitchALfoVal,int16_t pitchBLfoVal,int16_t filterLfoVal,uint16_t ampLfoVal) \
+{ \
+    /* SYNTH_VOICE_COUNT calls */ \
+    refreshVoice(0,envRouting,skipVoices,oscEnvAmt,filEnvAmt,pitchALfoVal,pitchBLfoVal,filterLfoVal,ampLfoVal); \
+    refreshVoice(1,envRouting,skipVoices,oscEnvAmt,filEnvAmt,pitchALfoVal,pitchBLfoVal,filterLfoVal,ampLfoVal); \
+    refreshVoice(2,envRouting,skipVoices,oscEnvAmt,filEnvAmt,pitchALfoVal,pitchBLfoVal,filterLfoVal,ampLfoVal); \
+    refreshVoice(3,envRouting,skipVoices,oscEnvAmt,filEnvAmt,pitchALfoVal,pitchBLfoVal,filterLfoVal,ampLfoVal); \
+    refreshVoice(4,envRouting,skipVoices,oscEnvAmt,filEnvAmt,pitchALfoVal,pitchBLfoVal,filterLfoVal,ampLfoVal); \
+    refreshVoice(5,envRouting,skipVoices,oscEnvAmt,filEnvAmt,pitchALfoVal,pitchBLfoVal,filterLfoVal,ampLfoVal); \
+}
+
+RENDER_VOICES(renderVoicesStandard,0)
+RENDER_VOICES(renderVoicesOscAmpEnv,1)
+RENDER_VOICES(renderVoicesPoly,2)
+RENDER_VOICES(renderVoicesGate,3)
+
+static const renderVoices_t renderVoicesForEnvRouting[4]=
+{
+    renderVoicesStandard,renderVoicesOscAmpEnv,renderVoicesPoly,renderVoicesGate
+};
+
+static void refreshRoutingPlan(void)
+{
+    uint8_t t=0;
+    uint8_t lfoTargets=currentPreset.steppedParameters[spLFOTargets];
+
+    switch(currentPreset.steppedParameters[spVibTarget])
+    {
+    case 0: // VCO A & B
+        t|=rtVibA|rtVibB;
+        break;
+    case 2: // VCO A
+        t|=rtVibA;
+        break;
+    case 3: // VCO B
+        t|=rtVibB;
+        break;
+    }
+
+    if(lfoTargets&mtVCO)
+    {
+        if(!(lfoTargets&mtOnlyB))
+            t|=rtLfoA;
+        if(!(lfoTargets&mtOnlyA))
+            t|=rtLfoB;
+    }
+
+    if(lfoTargets&mtVCF)
+        t|=rtLfoVCF;
+
+    if(lfoTargets&mtVCA)
+        t|=rtLfoVCA;
+
+    if(currentPreset.steppedParameters[spPModFA])
+        t|=rtPModFA;
 
+    BLOCK_INT
+    {
+        synth.routing.targets=t;
+        synth.routing.renderVoices=renderVoicesForEnvRouting[currentPreset.steppedParameters[spEnvRouting]&3];
+    }
+}
 
 static void handleBitInputs(void)
 {
@@ -1189,6 +1380,7 @@ void synth_init(void)
     // init
 
     memset(&synth,0,sizeof(synth));
+    synth.routing.renderVoices=renderVoicesStandard; // until refreshFullState()
 
     scanner_init();
     display_init();
@@ -1197,6 +1389,7 @@ void synth_init(void)
     tuner_init();
     assigner_init();
     uart_init();
+    profiler_reset();
     seq_init();
     arp_init();
     ui_init();
@@ -1239,6 +1432,14 @@ void synth_init(void)
         preset_saveCurrent(MANUAL_PRESET_PAGE);
     }
 
+    // which presets are there, once and for all
+
+    preset_loadDirectory();
+
+    // same for the sequences
+
+    seq_load();
+
     sh_setCV(pcMVol,HALF_RANGE,SH_FLAG_IMMEDIATE);
 
     // dead band pre calculation
@@ -1271,8 +1472,8 @@ void synth_init(void)
 void synth_update(void)
 {
     int32_t potVal;
+    uint8_t groups;
     static uint8_t frc=0;
-    //synth.updateCounter++;
 
     // toggle tape out (debug)
 
@@ -1322,6 +1523,20 @@ void synth_update(void)
         }
     }
 
+    // deferred refreshes, coalesced since the previous update
+
+    BLOCK_INT
+    {
+        groups=synth.pendingRefresh;
+        synth.pendingRefresh=0;
+    }
+
+    if(groups)
+    {
+        refreshGroups(groups);
+        ++synth.refreshes;
+    }
+
     // immediate response the value changes
 
     if (potmux_hasChanged(ppMVol))
@@ -1348,7 +1563,7 @@ void synth_update(void)
         }
         else
         {
-            synth.glideAmount=exponentialCourse(currentPreset.continuousParameters[cpGlide],11000.0f,2100.0f);
+            synth.glideAmount=exponentialCourse(currentPreset.continuousParameters[cpGlide],EXP_COEF(11000),2100);
             synth.gliding=synth.glideAmount<2000;
         }
     }
@@ -1357,7 +1572,7 @@ void synth_update(void)
     {
         synth.vibAmt=currentPreset.continuousParameters[cpVibAmt];
         synth.vibAmt=(synth.vibAmt<POT_DEAD_ZONE)?0:(synth.vibAmt-POT_DEAD_ZONE);
-        synth.vibAmt=((expf(((float)synth.vibAmt)/15000.0f )-1.0f)*870.0f);
+        synth.vibAmt=exponentialRise(synth.vibAmt,EXP_COEF(15000),870);
         ui.vibAmountChangePending=0;
     }
 
@@ -1400,7 +1615,7 @@ void synth_update(void)
             break;
         case 7:
             refreshGates();
-            synth.glideAmount=exponentialCourse(currentPreset.continuousParameters[cpGlide],11000.0f,2100.0f);
+            synth.glideAmount=exponentialCourse(currentPreset.continuousParameters[cpGlide],EXP_COEF(11000),2100);
             synth.gliding=synth.glideAmount<2000;
             // arp and seq
             clock_setSpeed(settings.seqArpClock);
@@ -1410,6 +1625,13 @@ void synth_update(void)
     // tuned CVs
 
     computeTunedCVs(0,-1);
+
+    // background bulk dump, panel moves, preset loads, saved pages
+
+    midi_dumpUpdate();
+    midi_sendUpdate();
+    preset_loadUpdate();
+    storage_update();
 }
 
 void synth_tuneSynth(void)
@@ -1429,6 +1651,84 @@ void synth_uartInterrupt(void)
     uart_update();
 }
 
+static void clockStep(void)
+{
+    if (clock_update())
+    {
+
+        // sync of the LFO using the clockBar counter
+
+        synth.clockBar=(synth.clockBar+1)%0x9; // make sure the counter stays within the counter range, here 0...9
+        if (currentPreset.steppedParameters[spLFOSync]>1)
+        {
+            if(seq_getMode(0)!=smOff || seq_getMode(1)!=smOff || arp_getMode()!=amOff)
+            {
+                if ((synth.clockBar==8 && currentPreset.steppedParameters[spLFOSync]==8) || synth.clockBar+1==currentPreset.steppedParameters[spLFOSync])
+                {
+                    synth.clockBar=0;
+                    lfo_resetPhase(&synth.lfo);
+                }
+            }
+        }
+
+        // sequencer
+
+        if(seq_getMode(0)!=smOff || seq_getMode(1)!=smOff)
+            seq_update();
+
+        // arpeggiator
+
+        if(arp_getMode()!=amOff)
+            arp_update();
+    }
+}
+
+static void realtimeEvent(uint8_t midiEvent, uint16_t stamp)
+{
+    if(settings.syncMode!=smMIDI)
+        return;
+
+    switch(midiEvent)
+    {
+    case MIDI_CLOCK:
+        // steps are taken by the tempo tracker, see handleRealtimeEvents()
+        extclock_pulse(stamp);
+        break;
+    case MIDI_START:
+        seq_resetCounter(0,0);
+        seq_resetCounter(1,0);
+        arp_resetCounter(0);
+        clock_reset(); // always do a beat reset on MIDI START
+        extclock_reset();
+        synth.pendingExtClock=0;
+        break;
+    case MIDI_STOP:
+        seq_silence(0);
+        seq_silence(1);
+        break;
+    }
+}
+
+static void handleRealtimeEvents(void)
+{
+    uint8_t tail,steps;
+
+    // the UART interrupt might add events meanwhile, they'll be seen here or next tick
+
+    while((tail=synth.realtimeTail)!=synth.realtimeHead)
+    {
+        realtimeEvent(synth.realtimeEvents[tail],synth.realtimeStamps[tail]);
+
+        synth.realtimeTail=(tail+1)&(REALTIME_QUEUE_SIZE-1);
+    }
+
+    // clock steps follow the tracked phase of the MIDI clock
+
+    if(settings.syncMode==smMIDI)
+        for(steps=extclock_update(synth.timerTicks);steps;--steps)
+            clockStep();
+}
+
 // 2Khz
 void synth_timerInterrupt(void)
 {
@@ -1436,45 +1736,42 @@ void synth_timerInterrupt(void)
     int16_t pitchALfoVal,pitchBLfoVal,filterLfoVal,filEnvAmt,oscEnvAmt;
     uint16_t ampLfoVal;
     int8_t v,hz63,hz250;
+    uint8_t targets=synth.routing.targets;
 
     static uint8_t frc=0;
 
-    // performance
-	// static uint16_t frc2=0; // for performance measurement
+    profiler_start();
+
+    BLOCK_INT
+    {
+        ++synth.timerTicks;
+    }
+
+    // a preset loaded by the main loop becomes current between two ticks
+
+    preset_loadSwap();
 
     // lfo
 
     lfo_update(&synth.lfo);
 
 
-    pitchALfoVal=pitchBLfoVal=0;
-    if (currentPreset.steppedParameters[spVibTarget]==2) // VCO A
-    {
-        pitchALfoVal=synth.vibPitch;
-    }
-    if (currentPreset.steppedParameters[spVibTarget]==3) // VCO B
-    {
-        pitchBLfoVal=synth.vibPitch;
-    }
-    if (currentPreset.steppedParameters[spVibTarget]==0) // VCO A & B
-    {
-        pitchALfoVal=pitchBLfoVal=synth.vibPitch;
-    }
+    // routing was compiled by refreshRoutingPlan()
+
+    pitchALfoVal=(targets&rtVibA)?synth.vibPitch:0;
+    pitchBLfoVal=(targets&rtVibB)?synth.vibPitch:0;
     ampLfoVal=synth.vibAmp;
     filterLfoVal=0;
 
-    if(currentPreset.steppedParameters[spLFOTargets]&mtVCO)
-    {
-        if(!(currentPreset.steppedParameters[spLFOTargets]&mtOnlyB))
-            pitchALfoVal+=synth.lfo.output>>1;
-        if(!(currentPreset.steppedParameters[spLFOTargets]&mtOnlyA))
-            pitchBLfoVal+=synth.lfo.output>>1;
-    }
+    if(targets&rtLfoA)
+        pitchALfoVal+=synth.lfo.output>>1;
+    if(targets&rtLfoB)
+        pitchBLfoVal+=synth.lfo.output>>1;
 
-    if(currentPreset.steppedParameters[spLFOTargets]&mtVCF)
+    if(targets&rtLfoVCF)
         filterLfoVal=synth.lfo.output;
 
-    if(currentPreset.steppedParameters[spLFOTargets]&mtVCA)
+    if(targets&rtLfoVCA)
     {
         ampLfoVal=scaleU16U16(ampLfoVal, synth.lfo.output+(UINT16_MAX-(synth.lfo.levelCV>>1)));
     }
@@ -1485,7 +1782,7 @@ void synth_timerInterrupt(void)
     vf+=INT16_MIN;
     filEnvAmt=vf;
     oscEnvAmt=0;
-    if(currentPreset.steppedParameters[spPModFA])
+    if(targets&rtPModFA)
     {
         va=currentPreset.continuousParameters[cpPModFilEnv];
         va+=INT16_MIN;
@@ -1493,20 +1790,26 @@ void synth_timerInterrupt(void)
         oscEnvAmt=va;
     }
 
+    profiler_lap(prsLFO);
+
     // per voice stuff
 
-    // SYNTH_VOICE_COUNT calls
-    refreshVoice(0,oscEnvAmt,filEnvAmt,pitchALfoVal,pitchBLfoVal,filterLfoVal,ampLfoVal);
-    refreshVoice(1,oscEnvAmt,filEnvAmt,pitchALfoVal,pitchBLfoVal,filterLfoVal,ampLfoVal);
-    refreshVoice(2,oscEnvAmt,filEnvAmt,pitchALfoVal,pitchBLfoVal,filterLfoVal,ampLfoVal);
-    refreshVoice(3,oscEnvAmt,filEnvAmt,pitchALfoVal,pitchBLfoVal,filterLfoVal,ampLfoVal);
-    refreshVoice(4,oscEnvAmt,filEnvAmt,pitchALfoVal,pitchBLfoVal,filterLfoVal,ampLfoVal);
-    refreshVoice(5,oscEnvAmt,filEnvAmt,pitchALfoVal,pitchBLfoVal,filterLfoVal,ampLfoVal);
+    // idle voices are refreshed in turn, one per tick
+
+    synth.routing.renderVoices(synth.idleVoices&~(1<<(frc&IDLE_VOICE_REFRESH_MASK)),oscEnvAmt,filEnvAmt,pitchALfoVal,pitchBLfoVal,filterLfoVal,ampLfoVal);
+
+    profiler_lap(prsVoices);
 
     // bit inputs (footswitch / tape in)
 
     handleBitInputs();
 
+    // MIDI clock, start & stop
+
+    handleRealtimeEvents();
+
+    profiler_lap(prsBitInputs);
+
     // slower updates
 
     hz63=(frc&0x1c)==0;
@@ -1518,50 +1821,26 @@ void synth_timerInterrupt(void)
         if(hz63)
             handleFinishedVoices();
 
-        // MIDI processing
-        midi_update(0);
+        // MIDI processing, the handlers that use the storage wait while the main loop does (see storage_isBusy())
+        midi_update();
 
         // ticker inc
         ++currentTick;
 
+        profiler_lap(prsMIDI);
         break;
     case 1:
 
         // sequencer & arpeggiator
 
+        // (MIDI clock steps are taken on each tick, see handleRealtimeEvents())
+
         if(settings.syncMode==smInternal || synth.pendingExtClock)
         {
             if(synth.pendingExtClock)
                 --synth.pendingExtClock;
 
-            if (clock_update())
-            {
-
-                // sync of the LFO using the clockBar counter
-
-                synth.clockBar=(synth.clockBar+1)%0x9; // make sure the counter stays within the counter range, here 0...9
-                if (currentPreset.steppedParameters[spLFOSync]>1)
-                {
-                    if(seq_getMode(0)!=smOff || seq_getMode(1)!=smOff || arp_getMode()!=amOff)
-                    {
-                        if ((synth.clockBar==8 && currentPreset.steppedParameters[spLFOSync]==8) || synth.clockBar+1==currentPreset.steppedParameters[spLFOSync])
-                        {
-                            synth.clockBar=0;
-                            lfo_resetPhase(&synth.lfo);
-                        }
-                    }
-                }
-
-                // sequencer
-
-                if(seq_getMode(0)!=smOff || seq_getMode(1)!=smOff)
-                    seq_update();
-
-                // arpeggiator
-
-                if(arp_getMode()!=amOff)
-                    arp_update();
-            }
+            clockStep();
         }
 
         // glide
@@ -1576,6 +1855,7 @@ void synth_timerInterrupt(void)
             }
         }
 
+        profiler_lap(prsClock);
         break;
     case 2:
         lfo_update(&synth.vibrato);
@@ -1590,30 +1870,26 @@ void synth_timerInterrupt(void)
             synth.vibAmp=UINT16_MAX;
         }
         refreshPulseWidth(currentPreset.steppedParameters[spLFOTargets]&mtPW);
+
+        profiler_lap(prsVibrato);
         break;
     case 3:
         if(hz250)
         {
-            scanner_update(hz63);
+            // keys always, buttons use the storage, so they wait while the main loop does
+            scanner_update(hz63 && !storage_isBusy());
             display_update(hz63);
             if (hz63)
                 ui_update();
         }
+
+        profiler_lap(prsScanner);
         break;
     }
 
     ++frc;
 
-    // for performance measurement
-    // frc2=(frc2+1)%0x07d0; // 1 second
-    //frc2=(frc2+1)%0x03e8; // 1/2 second
-    //frc2=(frc2+1)%0x07d; // 1/16 second
-
-    /*if(frc2==0)
-    {
-        midi_sendThreeBytes(0,(uint16_t)synth.updateCounter);
-        synth.updateCounter=0;
-    }*/
+    profiler_end();
 }
 
 ////////////////////////////////////////////////////////////////////////////////
@@ -1708,6 +1984,13 @@ void synth_assignerEvent(uint8_t note, int8_t gate, int8_t voice, uint16_t veloc
 {
     uint16_t velAmt;
 
+    // voice is in use again, back to full refresh rate
+
+    BLOCK_INT
+    {
+        synth.idleVoices&=~(1<<voice);
+    }
+
     // mod delay
 
     refreshModDelayLFORetrigger(0);
@@ -1749,9 +2032,35 @@ void synth_assignerEvent(uint8_t note, int8_t gate, int8_t voice, uint16_t veloc
 
 void synth_uartEvent(uint8_t data)
 {
+    uint8_t head,next;
+
+    // sync messages skip the MIDI parser and are timestamped, they are handled by the next
+    // timer interrupt instead of waiting for phase 0 and then phase 1 (up to 2.5ms of jitter)
+
+    if(data==MIDI_CLOCK || data==MIDI_START || data==MIDI_CONTINUE || data==MIDI_STOP)
+    {
+        head=synth.realtimeHead;
+        next=(head+1)&(REALTIME_QUEUE_SIZE-1);
+
+        if(next!=synth.realtimeTail)
+        {
+            synth.realtimeEvents[head]=data;
+            synth.realtimeStamps[head]=synth.timerTicks;
+            synth.realtimeHead=next;
+            return;
+        }
+
+        // queue full (interrupts blocked for long), the parser path is slower but won't lose it
+    }
+
     midi_newData(data);
 }
 
+int8_t synth_uartTxReady(uint8_t * data)
+{
+    return midi_nextSendByte(data);
+}
+
 static void retuneLastNotePressed(int16_t bend, uint16_t modulation, uint8_t mask)
 {
     uint8_t note = 0;
@@ -1816,7 +2125,7 @@ void synth_wheelEvent(int16_t bend, uint16_t modulation, uint8_t mask, int8_t is
             if (currentPreset.steppedParameters[spModwheelTarget]==1 && currentPreset.steppedParameters[spVibTarget]==1)
             {
                 // full strength for vib VCA modulation
-                synth.modwheelAmount=((uint16_t)((expf(((float)modulation)/30000.0f )-1.0f)*8310.08f));
+                synth.modwheelAmount=exponentialRise(modulation,EXP_COEF(30000),8310);
 
             }
             else
@@ -1825,15 +2134,15 @@ void synth_wheelEvent(int16_t bend, uint16_t modulation, uint8_t mask, int8_t is
                 modBitShift=mr[currentPreset.steppedParameters[spModWheelRange]];
                 if (currentPreset.steppedParameters[spModWheelRange]<=1)
                 {
-                    synth.modwheelAmount=(((uint16_t)((expf(((float)modulation)/30000.0f )-1.0f)*8310.08f))>>modBitShift);
+                    synth.modwheelAmount=exponentialRise(modulation,EXP_COEF(30000),8310)>>modBitShift;
                 }
                 else if(currentPreset.steppedParameters[spModWheelRange]==2)
                 {
-                    synth.modwheelAmount=(((uint16_t)((expf(((float)modulation)/17000.0f )-1.0f)*1417.6f))>>modBitShift);
+                    synth.modwheelAmount=exponentialRise(modulation,EXP_COEF(17000),1418)>>modBitShift;
                 }
                 else
                 {
-                    synth.modwheelAmount=((uint16_t)((expf(((float)modulation)/14000.0f )-1.0f)*613.12f));
+                    synth.modwheelAmount=exponentialRise(modulation,EXP_COEF(14000),613);
                 }
             }
             refreshLfoSettings();
@@ -1846,27 +2155,12 @@ void synth_wheelEvent(int16_t bend, uint16_t modulation, uint8_t mask, int8_t is
 
 }
 
+// from the MIDI parser (USB, or UART realtime queue overflow)
 void synth_realtimeEvent(uint8_t midiEvent)
 {
-    if(settings.syncMode!=smMIDI)
-        return;
-
-    switch(midiEvent)
+    BLOCK_INT
     {
-    case MIDI_CLOCK:
-        ++synth.pendingExtClock;
-        break;
-    case MIDI_START:
-        seq_resetCounter(0,0);
-        seq_resetCounter(1,0);
-        arp_resetCounter(0);
-        clock_reset(); // always do a beat reset on MIDI START
-        synth.pendingExtClock=0;
-        break;
-    case MIDI_STOP:
-        seq_silence(0);
-        seq_silence(1);
-        break;
+        realtimeEvent(midiEvent,synth.timerTicks);
     }
 }
 
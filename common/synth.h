@@ -9,6 +9,9 @@
 #define RELEASE "v2022-2"
 
 #define UART_USE_HW_INTERRUPT // this needs an additional wire that goes from pin C4 to pin E4
+#define PROFILER // cycle accounting for synth_timerInterrupt, see profiler.c
+//#define MIDI_RUNNING_STATUS // omit repeated status bytes in MIDI out, note offs become note ons with velocity 0, see midi.c
+#define MIDI_PANEL_NRPN // send pot moves as NRPN, instead of coarse/fine CC pairs, see midi.c
 
 #ifndef DEBUG
 	#ifdef RELEASE
@@ -30,6 +33,9 @@
 
 #define SYSEX_COMMAND_PATCH_DUMP 1
 #define SYSEX_COMMAND_PATCH_DUMP_REQUEST 2
+#define SYSEX_COMMAND_PROFILER_REQUEST 3 // data byte: 1 resets the stats after the dump
+#define SYSEX_COMMAND_PROFILER_DUMP 4
+#define SYSEX_COMMAND_PARAMETER_SNAPSHOT 5 // count, then records: cp (<0x80) & 16 bit value, or 0x80|sp & value
 #define SYSEX_COMMAND_UPDATE_FW 0x6b
 
 #define SYSEX_SUBID1_BULK_TUNING_DUMP 0x08
@@ -109,10 +115,25 @@ typedef enum
 	smInternal=0,smMIDI=1,smTape=2
 } syncMode_t;
 
+// parts of refreshFullState(), see synth_refreshLater()
+typedef enum
+{
+	rgRouting=1,	// voice render specialization, LFO/vibrato targets
+	rgModDelay=2,	// modulation delay, LFO retrigger
+	rgGates=4,		// oscillator waveform gates
+	rgAssigner=8,	// unison, priority, voice mask
+	rgLfo=16,		// LFO & vibrato shapes, amounts, frequencies
+	rgEnv=32,		// envelope shapes & CVs, spread
+	rgPitch=64,		// bender range & target, VCF limit
+	rgDisplay=128,	// seven segment & LEDs
+	rgAll=255
+} refreshGroup_t;
+
 void synth_buttonEvent(p600Button_t button, int pressed);
 void synth_keyEvent(uint8_t key, int pressed, int fromKeyboard, uint16_t velocity);
 void synth_assignerEvent(uint8_t note, int8_t gate, int8_t voice, uint16_t velocity, int8_t legato); // voice -1 is unison
 void synth_uartEvent(uint8_t data);
+int8_t synth_uartTxReady(uint8_t * data); // returns 0 if there is nothing to send
 void synth_wheelEvent(int16_t bend, uint16_t modulation, uint8_t mask, int8_t isInternal, int8_t outputToMidi);
 void synth_updateBender(void);
 void synth_updateMasterVolume(void); // to fix volume bug in 2.25
@@ -123,6 +144,9 @@ void synth_resetForLocalOffMode(void);
 void synth_holdEvent(int8_t hold, int8_t sendMidi, uint8_t isInternal);
 void refreshPresetMode(void);
 void synth_volEvent(uint16_t value);
+void synth_refreshLater(uint8_t groups); // refreshGroup_t bits, applied once by the next synth_update()
+void synth_getRefreshStats(uint32_t * requests, uint32_t * refreshes);
+void synth_resetRefreshStats(void);
 
 void synth_init(void);
 void synth_update(void);
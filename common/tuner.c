@@ -408,28 +408,36 @@ uint16_t tuner_computeCVPerOct(uint8_t note, p600CV_t cv)
 NOINLINE uint16_t tuner_computeCVFromNote(uint8_t note, uint8_t nextInterp, p600CV_t cv)
 {
 	uint8_t loOct,hiOct;
-	uint16_t value,loOctVal,hiOctVal;
-	uint32_t noteTuning; // in units of TUNING_UNITS_PER_SEMITONE
-  
-	loOct=note/12;
+	uint16_t value,loOctVal,hiOctVal,span,noteTuning,interp;
+
+	// every note on of a chord is a new note for its voice, so this is kept to 16x16 multiplies
+	// instead of being cached
+
+	loOct=((uint16_t)note*171)>>11; // note/12, exact for 8 bit values
 	hiOct=loOct+1;
 	
-	if(loOct<TUNER_OCTAVE_COUNT)
-		loOctVal=settings.tunes[loOct][cv];
-	else
-		loOctVal=extapolateUpperOctavesTunes(loOct,cv);
-
 	if(hiOct<TUNER_OCTAVE_COUNT)
+	{
+		loOctVal=settings.tunes[loOct][cv];
 		hiOctVal=settings.tunes[hiOct][cv];
+	}
 	else
+	{
+		loOctVal=(loOct<TUNER_OCTAVE_COUNT)?settings.tunes[loOct][cv]:extapolateUpperOctavesTunes(loOct,cv);
 		hiOctVal=extapolateUpperOctavesTunes(hiOct,cv);
-	
-	noteTuning=currentPreset.perNoteTuning[note%12];
-	noteTuning+=((uint32_t)nextInterp<<8)/12; // FIXME: avoid this divide?
-	
+	}
+
+	span=hiOctVal-loOctVal;
+
+	// in units of TUNING_UNITS_PER_SEMITONE, one octave is 1<<16 so it can carry into a whole span
+	interp=((uint32_t)nextInterp*0x5556)>>10; // (nextInterp<<8)/12, exact for 8 bit values
+	noteTuning=currentPreset.perNoteTuning[note-loOct*12]+interp;
+
 	value=loOctVal;
-	value+=(noteTuning*(hiOctVal-loOctVal))>>16;
-	
+	if(noteTuning<interp)
+		value+=span;
+	value+=((uint32_t)noteTuning*span)>>16;
+
 	return value;
 }
 
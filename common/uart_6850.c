@@ -4,42 +4,66 @@
 
 #include "uart_6850.h"
 
+#define UART_CONTROL 0b10010101 // clock/16 - 8N1 - receive int
+#define UART_CONTROL_TX_INT 0b00100000 // transmit int, holds IRQ (to INT4, see UART_USE_HW_INTERRUPT) low while the transmit register is empty
+
+static struct
+{
+	uint8_t control;
+} uart;
+
 void uart_init(void)
 {
 	mem_write(0x6000,0b00000011); // master reset
 	MDELAY(1);
 	
-	mem_write(0x6000,0b10010101); // clock/16 - 8N1 - receive int
+	uart.control=UART_CONTROL;
+	mem_write(0x6000,uart.control);
 	CYCLE_WAIT(8);
 	
 	mem_read(0xe000); // read status to start the device
 	CYCLE_WAIT(8);
 }
 
-void NOINLINE uart_send(uint8_t data)
+void uart_setTxInterrupt(int8_t on)
 {
-		uint8_t status;
-
-	// wait until previous byte is transmitted
-
-	do
+	uint8_t control=on?UART_CONTROL|UART_CONTROL_TX_INT:UART_CONTROL;
+	
+	BLOCK_INT
 	{
-		BLOCK_INT
+		if(control!=uart.control)
 		{
-			status=mem_read(0xe000);
+			uart.control=control;
+			mem_write(0x6000,control);
+			CYCLE_WAIT(4);
 		}
-		
-		CYCLE_WAIT(4);
 	}
-	while(!(status&0x02));
-
-	// send the new one
+}
 
+int8_t uart_trySend(uint8_t data)
+{
+	int8_t sent=0;
+	
 	BLOCK_INT
 	{
-		mem_write(0x6001,data);
-		CYCLE_WAIT(4);
+		// only if the previous byte left the transmit register
+		
+		if(mem_read(0xe000)&0x02)
+		{
+			CYCLE_WAIT(4);
+			mem_write(0x6001,data);
+			CYCLE_WAIT(4);
+			sent=1;
+		}
 	}
+	
+	return sent;
+}
+
+void NOINLINE uart_send(uint8_t data)
+{
+	while(!uart_trySend(data))
+		CYCLE_WAIT(4);
 }
 
 void uart_update(void)
@@ -62,10 +86,26 @@ void uart_update(void)
 			return;
 		}
 
+		// transmit register empty, feed it or stop the transmit int if there's nothing left to send
+
+		if((status&0x02) && (uart.control&UART_CONTROL_TX_INT))
+		{
+			if(synth_uartTxReady(&data))
+			{
+				mem_write(0x6001,data);
+				CYCLE_WAIT(4);
+			}
+			else
+			{
+				uart_setTxInterrupt(0);
+			}
+		}
+
 		if(!(status&0x01))
 		{
 #ifdef DEBUG
-			print("Error: UART IRQ without data\n");
+			if(!(uart.control&UART_CONTROL_TX_INT))
+				print("Error: UART IRQ without data\n");
 #endif	
 			return;
 		}
@@ -92,4 +132,3 @@ void uart_update(void)
 		synth_uartEvent(data);
 	}
 }
-
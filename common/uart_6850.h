@@ -4,7 +4,9 @@
 #include "synth.h"
 
 void uart_init(void);
-void uart_send(uint8_t data);
+void uart_send(uint8_t data); // polled, waits until the transmit register is empty
+int8_t uart_trySend(uint8_t data); // returns 0 if the transmit register is still busy
+void uart_setTxInterrupt(int8_t on); // transmit register empty raises the UART interrupt, see synth_uartTxReady()
 void uart_update(void);
 
 #endif	/* UART_6850_H */
@@ -10,6 +10,7 @@
 #include "display.h"
 #include "potmux.h"
 #include "midi.h"
+#include "extclock.h"
 #include "stdio.h"
 
 const struct uiParam_s uiParameters[] =
@@ -260,7 +261,15 @@ static LOWERCODESIZE void handleMiscAction(p600Button_t button)
 				sevenSeg_scrollText("Int sync",1);
 				break;
 			case smMIDI:
-				sevenSeg_scrollText("Midi sync",1);
+				if(extclock_getBPM())
+				{
+					sprintf(s,"Midi sync %u bpm",extclock_getBPM());
+					sevenSeg_scrollText(s,1);
+				}
+				else
+				{
+					sevenSeg_scrollText("Midi sync",1);
+				}
 				break;
 			case smTape:
 				sevenSeg_scrollText("tape sync",1);
@@ -348,6 +357,7 @@ static LOWERCODESIZE void displayUIParameter(int8_t num)
 {
 	int8_t i;
 	char s[20];
+	uint8_t stepped[spCount]; // not tempBuffer, a patch dump may be coming in it
 	const struct uiParam_s * prm = &uiParameters[ui.activeParamIdx];
 
 	strcpy(s,prm->name);
@@ -364,11 +374,11 @@ static LOWERCODESIZE void displayUIParameter(int8_t num)
             break;
         case ptCust:
             // reverse lookup for uiParam value (assumes only steppedParameters will be modified)
-            memcpy(tempBuffer,currentPreset.steppedParameters,sizeof(currentPreset.steppedParameters));
+            memcpy(stepped,currentPreset.steppedParameters,sizeof(currentPreset.steppedParameters));
             for(i=0;i<4;++i)
             {
                 setCustomParameter(prm->number,i);
-                if(!memcmp(tempBuffer,currentPreset.steppedParameters,sizeof(currentPreset.steppedParameters)))
+                if(!memcmp(stepped,currentPreset.steppedParameters,sizeof(currentPreset.steppedParameters)))
                 {
                     strcat(s,prm->values[i]);
                     break;
@@ -478,17 +488,17 @@ void ui_checkIfDataPotChanged(void)
 
     if (ui.isShifted && settings.presetMode && (ui.digitInput==diLoadUnitDigit || ui.digitInput==diLoadDecadeDigit)) // this is preset load patch - we want the data dial to work as selector
     {
-        // map dial onto 0...99
+        // map dial onto all the presets, 0...199
         // if in local off mode we can still change the program because the incoming MIDI would have no effect
         uint16_t selectedPatch;
         //char s[50];
-        selectedPatch=(data*100)>>16; // this divides the total range (16 bits) into 0...99 range using effectively a floor() function
+        selectedPatch=(data*PRESET_COUNT)>>16; // this divides the total range (16 bits) into 0...199 range using effectively a floor() function
 
         if (selectedPatch==settings.presetNumber) return;
 
         if(preset_loadCurrent(selectedPatch,0))
         {
-            midi_sendProgChange(settings.presetNumber); // only send when new prog is selected
+            midi_sendProgChange(selectedPatch); // only send when new prog is selected
             refreshFullState();
             ui.presetModified=0;
         }
@@ -557,10 +567,16 @@ void ui_checkIfDataPotChanged(void)
 	}
 }
 
+// the two digits of the number pad select a preset in the hundred of the current one, the data dial reaches them all
+static int16_t presetBankTens(void)
+{
+	return (settings.presetNumber/100)*10;
+}
+
 void LOWERCODESIZE ui_handleButton(p600Button_t button, int pressed)
 {
 	int8_t recordOverride=0;
-    char s[15];
+    char s[20];
 
 	// button press might change current preset
 
@@ -727,10 +743,8 @@ void LOWERCODESIZE ui_handleButton(p600Button_t button, int pressed)
         }
         else if (ui.isInPatchManagement && button==pbPreset)
         {
-            // dump the patch bank
+            // dump the patch bank, in the background (see midi_dumpUpdate())
             midi_dumpPresets();
-            sevenSeg_scrollText("presets dumped",1);
-            refreshPresetMode();
             ui.digitInput=diStoreDecadeDigit;
         }
         else if ((ui.isShifted || ui.isDoubleClicked) && ((button>=pb0 && button<=pb9) || button==pbTune || button==pbPreset || button==pbRecord))
@@ -811,11 +825,11 @@ void LOWERCODESIZE ui_handleButton(p600Button_t button, int pressed)
 			switch(ui.digitInput)
 			{
                 case diLoadDecadeDigit: // this is the first press of the preset select
-                    ui.presetAwaitingNumber=button-pb0;
+                    ui.presetAwaitingNumber=presetBankTens()+button-pb0;
                     ui.digitInput=diLoadUnitDigit;
                     break;
                 case diStoreDecadeDigit: // this is the first press of the prese store
-                    ui.presetAwaitingNumber=button-pb0;
+                    ui.presetAwaitingNumber=presetBankTens()+button-pb0;
                     ui.digitInput=diStoreUnitDigit;
                     break;
                 case diLoadUnitDigit: // this is the first press of the preset select
@@ -828,7 +842,11 @@ void LOWERCODESIZE ui_handleButton(p600Button_t button, int pressed)
                         if(ui.digitInput==diStoreUnitDigit)
                         {
                             if (!settings.presetMode) preset_saveCurrent(MANUAL_PRESET_PAGE); // make sure that the latest parameters are stored for live mode
-                            preset_saveCurrent(ui.presetAwaitingNumber);
+                            if (!preset_saveCurrent(ui.presetAwaitingNumber)) // an older preset has the page, it must be stored again first
+                            {
+                                sprintf(s, "store %u first", ui.presetAwaitingNumber%PRESET_PAGE_COUNT);
+                                sevenSeg_scrollText(s,1);
+                            }
                         }
                         // if in local off mode we can still change the program because the incoming MIDI would have no effect
                         // also: always try to load/reload preset
@@ -25,7 +25,7 @@ struct ui_s
 	enum uiDigitInput_e digitInput;
     uint8_t vibAmountChangePending;
     uint8_t vibFreqChangePending;
-	int8_t presetAwaitingNumber;
+	int16_t presetAwaitingNumber;
 	int8_t presetModified;
 
 	p600Pot_t lastActivePot;
@@ -3,6 +3,7 @@
 ////////////////////////////////////////////////////////////////////////////////
 
 #include "utils.h"
+#include "exp_lookups.h"
 
 inline uint16_t satAddU16U16(uint16_t a, uint16_t b)
 {
@@ -148,9 +149,77 @@ inline uint32_t lfsr(uint32_t v, uint8_t taps)
 	return v;
 }
 
-uint16_t exponentialCourse(uint16_t v, float ratio, float range)
+// 2^(frac/65536), in 16.16 fixed point, linearly interpolated between table entries
+static uint32_t exp2Mantissa(uint16_t frac)
 {
-	return expf(-(float)v/ratio)*range;
+	uint8_t i,f;
+	uint32_t a,b;
+
+	i=frac>>8;
+	f=frac;
+
+	a=pgm_read_word(&exp2Lookup[i]);
+	b=(i==255)?65536:pgm_read_word(&exp2Lookup[i+1]);
+
+	return 65536+a+(((b-a)*f+128)>>8);
+}
+
+// 2^(x/65536), in 16.16 fixed point
+// relative error is below 2e-5, plus 0.5 LSB of rounding for negative x
+uint32_t exp2Fixed(int32_t x)
+{
+	int8_t n;
+	uint32_t m;
+
+	n=x>>16;
+
+	if(n>=16)
+		return UINT32_MAX;
+	if(n<-17)
+		return 0;
+
+	m=exp2Mantissa(x);
+
+	if(n>=0)
+		return m<<n;
+	else
+		return (m+(1UL<<(-n-1)))>>-n;
+}
+
+// range*e^(-v/ratio), coef=EXP_COEF(ratio)
+// within 0.05% + 1 LSB of the float version, see host/test/exp_test.c
+uint16_t exponentialCourse(uint16_t v, uint32_t coef, uint16_t range)
+{
+	int32_t x;
+	int8_t shift;
+
+	x=-(int32_t)(((uint32_t)v*coef+2048)>>12);
+
+	// scale before shifting, to keep the precision of the mantissa for small results
+
+	shift=15-(x>>16);
+	if(shift>=32)
+		return 0;
+
+	return ((uint32_t)range*(exp2Mantissa(x)>>1))>>shift;
+}
+
+// scale*(e^(v/ratio)-1), coef=EXP_COEF(ratio), saturated to 16 bits
+// within 0.05% + scale/65536 + 1 LSB of the float version, see host/test/exp_test.c
+uint16_t exponentialRise(uint16_t v, uint32_t coef, uint16_t scale)
+{
+	uint32_t d,r;
+
+	d=exp2Fixed(((uint32_t)v*coef+2048)>>12)-65536;
+
+	// keep full precision for small values, avoid overflowing for the big ones
+
+	if(d<65536)
+		r=(d*scale)>>16;
+	else
+		r=((d>>4)*scale)>>12;
+
+	return MIN(r,UINT16_MAX);
 }
 
 
@@ -30,7 +30,12 @@ uint16_t computeShape(uint32_t phase, const uint16_t lookup[], int8_t interpolat
 
 uint32_t lfsr(uint32_t v, uint8_t taps);
 
-uint16_t exponentialCourse(uint16_t v, float ratio, float range);
+// log2(e)/ratio in 4.28 fixed point, ratio must be a constant between 7500 and 65535 (no float at runtime)
+#define EXP_COEF(ratio) ((uint32_t)(1.4426950408889634*(1UL<<28)/(ratio)+0.5))
+
+uint32_t exp2Fixed(int32_t x);
+uint16_t exponentialCourse(uint16_t v, uint32_t coef, uint16_t range);
+uint16_t exponentialRise(uint16_t v, uint32_t coef, uint16_t scale);
 
 int uint16Compare(const void * a,const void * b); // for qsort
 
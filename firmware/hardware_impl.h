@@ -7,6 +7,8 @@
 #define CYCLE_WAIT(cycles) __builtin_avr_delay_cycles(4*cycles);
 #define BLOCK_INT ATOMIC_BLOCK(ATOMIC_RESTORESTATE)
 #define MDELAY(ms) _delay_ms(ms)
+#define CYCLE_COUNT() TCNT1 // free running, see hardware_init()
+#define CYCLE_COUNT_PER_TICK (F_CPU/2000)
 
 #endif	/* HARDWARE_IMPL_H */
 
@@ -245,6 +245,11 @@ static FORCEINLINE void hardware_init(int8_t ints)
 		TCCR0B|=(1<<CS01) | (1<<CS00);  //Timer 0 prescaler = 64
 		TIMSK0|=(1<<OCIE0A); //Enable overflow interrupt for Timer0
 
+		// Timer 1 free running at CPU clock, for CYCLE_COUNT()
+
+		TCCR1A=0;
+		TCCR1B=(1<<CS10);
+
 #ifdef UART_USE_HW_INTERRUPT	
 		EIMSK|=(1<<INT4); // enable INT4
 #else
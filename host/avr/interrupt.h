@@ -0,0 +1,13 @@
+#ifndef FAKE_AVR_INTERRUPTS_H
+#define FAKE_AVR_INTERRUPTS_H
+
+// lets xnormidi/bytequeue/interrupt_setting.c build on the host, see p600host.c
+
+#include <stdint.h>
+
+extern volatile uint8_t host_intLevel;
+
+#define SREG host_intLevel
+#define cli() (++host_intLevel)
+
+#endif
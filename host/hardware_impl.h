@@ -0,0 +1,27 @@
+#ifndef HARDWARE_IMPL_H
+#define	HARDWARE_IMPL_H
+
+#include <stdint.h>
+
+////////////////////////////////////////////////////////////////////////////////
+// Host (Linux) mockup of the low level interface, see p600host.c
+////////////////////////////////////////////////////////////////////////////////
+
+extern volatile uint8_t host_intLevel; // >0 -> interrupts disabled
+
+uint8_t host_blockInt(void);
+void host_restoreInt(const uint8_t * level);
+void host_cycleWait(uint32_t cycles);
+void host_mdelay(uint32_t ms);
+uint16_t host_cycleCount(void);
+
+#define CYCLE_WAIT(cycles) host_cycleWait(4*(cycles));
+#define BLOCK_INT for(uint8_t host_level __attribute__((cleanup(host_restoreInt)))=host_blockInt(), host_once=1; host_once; host_once=0)
+#define MDELAY(ms) host_mdelay(ms)
+#define CYCLE_COUNT() host_cycleCount() // counts bus accesses, not cycles
+#define CYCLE_COUNT_PER_TICK 500 // bus accesses that fit in a 2Khz tick (HOST_TIMER_CYCLES/HOST_BUS_CYCLES)
+
+// avr-libc extension, not part of glibc
+char * itoa(int value, char * s, int radix);
+
+#endif	/* HARDWARE_IMPL_H */
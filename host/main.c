@@ -0,0 +1,133 @@
+////////////////////////////////////////////////////////////////////////////////
+// Virtual P600 command line runner
+////////////////////////////////////////////////////////////////////////////////
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <time.h>
+
+#include "p600host.h"
+#include "sh.h"
+#include "potmux.h"
+#include "midi.h"
+
+static void usage(void)
+{
+	fprintf(stderr,
+		"usage: p600host [-s seconds] [-l logfile] [-a] [-m midifile] [-e eeprom]\n"
+		"  -s  virtual time to run (default 1)\n"
+		"  -l  write the event log to logfile ('-' for stdout)\n"
+		"  -a  also log DAC writes and timer ticks\n"
+		"  -m  feed raw MIDI bytes from midifile into the UART, at wire rate\n"
+		"  -e  EEPROM image, loaded if present and saved on exit\n");
+}
+
+static int8_t loadMidi(const char * fileName)
+{
+	FILE * f;
+	uint8_t buf[4096];
+	size_t size;
+
+	f=fopen(fileName,"rb");
+	if(!f)
+		return 0;
+
+	while((size=fread(buf,1,sizeof(buf),f))>0)
+		host_midiIn(buf,size);
+
+	fclose(f);
+	return 1;
+}
+
+int main(int argc, char * argv[])
+{
+	double seconds=1.0;
+	const char * logName=NULL, * midiName=NULL, * eepromName=NULL;
+	FILE * logFile=NULL;
+	int8_t logAll=0;
+	clock_t start;
+	double wall;
+	uint32_t cvWrites,shWrites,shSkips,potConversions,potRounds;
+	uint8_t potPeak,sendHighWater;
+	uint16_t sendOverflows;
+	int c;
+
+	while((c=getopt(argc,argv,"s:l:am:e:h"))!=-1)
+	{
+		switch(c)
+		{
+		case 's':
+			seconds=atof(optarg);
+			break;
+		case 'l':
+			logName=optarg;
+			break;
+		case 'a':
+			logAll=1;
+			break;
+		case 'm':
+			midiName=optarg;
+			break;
+		case 'e':
+			eepromName=optarg;
+			break;
+		default:
+			usage();
+			return 1;
+		}
+	}
+
+	if(logName)
+	{
+		logFile=(logName[0]=='-' && !logName[1])?stdout:fopen(logName,"w");
+		if(!logFile)
+		{
+			perror(logName);
+			return 1;
+		}
+	}
+
+	host_init(logFile);
+	host_logAll(logAll);
+
+	if(eepromName)
+		host_loadStorage(eepromName);
+
+	if(midiName && !loadMidi(midiName))
+	{
+		perror(midiName);
+		return 1;
+	}
+
+	start=clock();
+
+	host_boot();
+	host_run(seconds*HOST_CPU_HZ);
+
+	wall=(double)(clock()-start)/CLOCKS_PER_SEC;
+
+	if(eepromName)
+		host_saveStorage(eepromName);
+
+	fprintf(stderr,"virtual time    %.3f ms\n",host_cyclesToMs(host.cycle));
+	fprintf(stderr,"timer ticks     %u (%u missed)\n",host.ticks,host.missedTicks);
+	fprintf(stderr,"bus accesses    %u\n",host.busAccesses);
+	for(c=0,cvWrites=0;c<32;++c)
+		cvWrites+=host.cvWrites[c];
+
+	fprintf(stderr,"S&H writes      %u\n",cvWrites);
+	sh_getStats(&shWrites,&shSkips);
+	fprintf(stderr,"S&H cache       %u skipped (%.1f%%)\n",shSkips,shWrites+shSkips?100.0*shSkips/(shWrites+shSkips):0.0);
+	potmux_getStats(&potConversions,&potRounds,&potPeak);
+	fprintf(stderr,"pot conversions %u (%.2f rounds avg, %u peak per update)\n",potConversions,potConversions?(double)potRounds/potConversions:0.0,potPeak);
+	fprintf(stderr,"MIDI out bytes  %u (%u overruns)\n",host.midiOutBytes,host.midiOutOverruns);
+	midi_getSendStats(&sendHighWater,&sendOverflows);
+	fprintf(stderr,"MIDI send queue %u high water, %u overflows\n",sendHighWater,sendOverflows);
+	fprintf(stderr,"host time       %.3f s (x%.1f)\n",wall,wall>0?host.cycle/(double)HOST_CPU_HZ/wall:0.0);
+
+	if(logFile && logFile!=stdout)
+		fclose(logFile);
+
+	return 0;
+}
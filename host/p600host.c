@@ -0,0 +1,531 @@
+////////////////////////////////////////////////////////////////////////////////
+// Virtual P600: recording mockup of the hardware.h low level interface
+////////////////////////////////////////////////////////////////////////////////
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "p600host.h"
+#include "storage.h"
+#include "scanner.h"
+
+struct host_s host;
+volatile uint8_t host_intLevel=0;
+
+static uint8_t storageImage[STORAGE_SIZE];
+static uint8_t dacHigh;
+static int8_t selectedPot;
+static int8_t displayArmed;
+static uint8_t tunerStatus;
+
+static const char * eventNames[]={"dac","cv","gate","display","midiout","tick"};
+
+#define LOG_DEFAULT_MASK (~((1<<hevDAC)|(1<<hevTick)))
+
+static uint8_t logFileMask=LOG_DEFAULT_MASK;
+
+static void logEvent(hostEventType_t type, uint8_t index, uint16_t value)
+{
+	struct hostEvent_s * e;
+
+	e=&host.log[host.logCount%HOST_LOG_SIZE];
+	e->cycle=host.cycle;
+	e->type=type;
+	e->index=index;
+	e->value=value;
+	++host.logCount;
+
+	if(host.logFile && (logFileMask&(1<<type)))
+		fprintf(host.logFile,"%.1f %s %u %u\n",host.cycle*1e6/HOST_CPU_HZ,eventNames[type],index,value);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// Virtual interrupts
+////////////////////////////////////////////////////////////////////////////////
+
+static void dispatchInterrupts(void)
+{
+	static int8_t inTimer=0,inUart=0;
+
+	if(host_intLevel)
+		return;
+
+	// the UART interrupt (INT4 on the board) has priority and can nest into the timer handler
+
+	if(!inUart && hardware_getNMIState())
+	{
+		inUart=1;
+		synth_uartInterrupt();
+		inUart=0;
+	}
+
+	if(!inTimer && host.cycle>=host.nextTimer)
+	{
+		inTimer=1;
+
+		host.nextTimer+=HOST_TIMER_CYCLES;
+		++host.ticks;
+		logEvent(hevTick,0,host.ticks);
+
+		synth_timerInterrupt();
+
+		// the AVR only keeps one pending compare match, the others are lost
+		while(host.nextTimer+HOST_TIMER_CYCLES<=host.cycle)
+		{
+			host.nextTimer+=HOST_TIMER_CYCLES;
+			++host.missedTicks;
+		}
+
+		inTimer=0;
+	}
+}
+
+static void advance(uint32_t cycles)
+{
+	host.cycle+=cycles;
+	dispatchInterrupts();
+}
+
+uint8_t host_blockInt(void)
+{
+	uint8_t level=host_intLevel;
+	host_intLevel=1;
+	return level;
+}
+
+void host_restoreInt(const uint8_t * level)
+{
+	host_intLevel=*level;
+	dispatchInterrupts();
+}
+
+void host_cycleWait(uint32_t cycles)
+{
+	advance(cycles);
+}
+
+void host_mdelay(uint32_t ms)
+{
+	advance(ms*(HOST_CPU_HZ/1000));
+}
+
+uint16_t host_cycleCount(void)
+{
+	return host.busAccesses;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// hardware.h implementation
+////////////////////////////////////////////////////////////////////////////////
+
+void mem_write(uint16_t address, uint8_t value)
+{
+	++host.busAccesses;
+
+	switch(address)
+	{
+	case 0x4001: // DAC high bits
+		dacHigh=value&0x3f;
+		break;
+	case 0x4000: // DAC low bits, completes the write
+		host.dac=((uint16_t)dacHigh<<10)|((uint16_t)value<<2);
+		logEvent(hevDAC,0,host.dac);
+		break;
+	case 0x6000: // 6850 control
+		host.uartControl=value;
+		break;
+	case 0x6001: // 6850 transmit data, the byte takes the wire time to leave the transmit register
+		if(host.cycle<host.nextMidiOut)
+			++host.midiOutOverruns;
+		host.nextMidiOut=MAX(host.nextMidiOut,host.cycle)+HOST_MIDI_BYTE_CYCLES;
+		++host.midiOutBytes;
+		logEvent(hevMidiOut,0,value);
+		break;
+	default:
+		;
+	}
+
+	advance(HOST_BUS_CYCLES);
+}
+
+void io_write(uint8_t address, uint8_t value)
+{
+	uint8_t banks,cv;
+
+	++host.busAccesses;
+
+	switch(address)
+	{
+	case 0x08: // scanner row or display column
+		if(value<0x10)
+		{
+			host.scanRow=value;
+		}
+		else
+		{
+			host.displayCol=(value&0x10)?0:((value&0x20)?1:2);
+			displayArmed=1;
+		}
+		break;
+	case 0x09: // display data
+		if(displayArmed)
+		{
+			displayArmed=0;
+			if(host.displayRows[host.displayCol]!=value)
+			{
+				host.displayRows[host.displayCol]=value;
+				logEvent(hevDisplay,host.displayCol,value);
+			}
+		}
+		break;
+	case 0x0a: // pot multiplexer
+		if((value&0x30)==0x20)
+			selectedPot=value&0x0f;
+		else if((value&0x30)==0x10)
+			selectedPot=16+(value&0x0f);
+		else
+			selectedPot=-1;
+		break;
+	case 0x0b: // gates
+		if(host.gates!=value)
+			logEvent(hevGate,0,value);
+		host.gates=value;
+		break;
+	case 0x0d: // S&H demux, bits 3-7 are active low bank selects
+		banks=(~value)&0xf8;
+		if(banks)
+		{
+			cv=(value&0x07)|((__builtin_ctz(banks)-3)<<3);
+			if(cv<32)
+			{
+				host.cvs[cv]=host.dac;
+				++host.cvWrites[cv];
+				logEvent(hevCV,cv,host.dac);
+			}
+		}
+		break;
+	default:
+		;
+	}
+
+	advance(HOST_BUS_CYCLES);
+}
+
+static int8_t midiInReady(void)
+{
+	return host.midiInPos<host.midiInSize && host.cycle>=host.nextMidiIn;
+}
+
+uint8_t mem_read(uint16_t address)
+{
+	uint8_t v=0;
+
+	++host.busAccesses;
+
+	switch(address)
+	{
+	case 0xe000: // 6850 status
+		if(host.cycle>=host.nextMidiOut)
+			v|=0x02;
+		if(midiInReady())
+			v|=0x01;
+		if(hardware_getNMIState())
+			v|=0x80;
+		break;
+	case 0xe001: // 6850 receive data
+		if(midiInReady())
+		{
+			v=host.midiIn[host.midiInPos++];
+			host.nextMidiIn=MAX(host.nextMidiIn,host.cycle)+HOST_MIDI_BYTE_CYCLES;
+		}
+		break;
+	default:
+		;
+	}
+
+	advance(HOST_BUS_CYCLES);
+
+	return v;
+}
+
+uint8_t io_read(uint8_t address)
+{
+	uint8_t v=0;
+
+	++host.busAccesses;
+
+	switch(address)
+	{
+	case 0x09: // comparator, footswitch, tape in and tuner flip flop
+		v=host.bitInputs&0x21;
+		if(selectedPot>=0 && host.dac<host.pots[selectedPot])
+			v|=0x08;
+		// no oscillators here, let tuner status waits go through
+		tunerStatus^=0x06;
+		v|=tunerStatus;
+		break;
+	case 0x0a: // scanner
+		v=host.keyRows[host.scanRow&0x0f];
+		break;
+	default:
+		;
+	}
+
+	advance(HOST_BUS_CYCLES);
+
+	return v;
+}
+
+int8_t hardware_getNMIState(void)
+{
+	// 6850 IRQ, receive data or transmit register empty with the transmit int enabled
+	return midiInReady() || ((host.uartControl&0x60)==0x20 && host.cycle>=host.nextMidiOut);
+}
+
+// I2C transfers are bit banged, interrupts can come in between the bytes
+static void storageWait(uint32_t cycles)
+{
+	uint32_t i;
+
+	if(!host.storageLatency)
+		return;
+
+	for(i=0;i<STORAGE_PAGE_SIZE;++i)
+		advance(cycles/STORAGE_PAGE_SIZE);
+}
+
+void storage_write(uint32_t pageIdx, uint8_t *buf)
+{
+	if(pageIdx<(STORAGE_SIZE/STORAGE_PAGE_SIZE))
+		memcpy(&storageImage[pageIdx*STORAGE_PAGE_SIZE],buf,STORAGE_PAGE_SIZE);
+
+	++host.storageWrites;
+	host.lastStorageWrite=pageIdx;
+	storageWait(HOST_STORAGE_WRITE_CYCLES);
+}
+
+void storage_read(uint32_t pageIdx, uint8_t *buf)
+{
+	if(pageIdx<(STORAGE_SIZE/STORAGE_PAGE_SIZE))
+		memcpy(buf,&storageImage[pageIdx*STORAGE_PAGE_SIZE],STORAGE_PAGE_SIZE);
+
+	++host.storageReads;
+	storageWait(HOST_STORAGE_READ_CYCLES);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// Misc firmware support
+////////////////////////////////////////////////////////////////////////////////
+
+void phex(unsigned char c)
+{
+	fprintf(stderr,"%02X",c);
+}
+
+void phex16(unsigned int i)
+{
+	fprintf(stderr,"%04X",i&0xffff);
+}
+
+char * itoa(int value, char * s, int radix)
+{
+	if(radix==16)
+		sprintf(s,"%x",value);
+	else
+		sprintf(s,"%d",value);
+	return s;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// Host control
+////////////////////////////////////////////////////////////////////////////////
+
+void host_init(FILE * logFile)
+{
+	memset(&host,0,sizeof(host));
+	memset(storageImage,0xff,sizeof(storageImage)); // erased EEPROM
+
+	host.logFile=logFile;
+	host.bitInputs=0x20; // footswitch released
+	host.pots[ppMVol]=HALF_RANGE;
+	host.pots[ppMixer]=UINT16_MAX;
+	host.pots[ppCutoff]=UINT16_MAX;
+	host.pots[ppAmpSus]=UINT16_MAX;
+	host.pots[ppFilEnvAmt]=HALF_RANGE;
+	host.pots[ppPModFilEnv]=HALF_RANGE;
+	host.pots[ppPitchWheel]=HALF_RANGE;
+	host.pots[ppFreqBFine]=HALF_RANGE;
+	host.pots[ppMTune]=HALF_RANGE;
+
+	selectedPot=-1;
+	displayArmed=0;
+	host_intLevel=0;
+}
+
+void host_logAll(int8_t all)
+{
+	logFileMask=all?0xff:LOG_DEFAULT_MASK;
+}
+
+void host_boot(void)
+{
+	host_intLevel=1; // no interrupts while we init
+
+	// there are no oscillators to tune on the host, start from the theoretical tuning instead
+	if(!settings_load())
+	{
+		settings_loadDefault();
+		settings_save();
+	}
+
+	synth_init();
+
+	host.nextTimer=host.cycle+HOST_TIMER_CYCLES;
+	host.nextMidiIn=host.cycle;
+	host.nextMidiOut=host.cycle;
+	host_intLevel=0;
+}
+
+void host_run(uint64_t cycles)
+{
+	uint64_t end=host.cycle+cycles;
+
+	while(host.cycle<end)
+	{
+		synth_update();
+		dispatchInterrupts();
+	}
+}
+
+void host_setPot(p600Pot_t pot, uint16_t value)
+{
+	host.pots[pot]=value;
+}
+
+static void setScannerBit(uint8_t idx, int8_t on)
+{
+	uint8_t mask=1<<(idx&7);
+
+	host.keyRows[idx>>3]&=~mask;
+	if(on)
+		host.keyRows[idx>>3]|=mask;
+}
+
+void host_setButton(p600Button_t button, int8_t pressed)
+{
+	setScannerBit(button,pressed);
+}
+
+void host_setKey(uint8_t note, int8_t pressed)
+{
+	if(note>=SCANNER_BASE_NOTE && note<=SCANNER_C5)
+		setScannerBit(note-SCANNER_BASE_NOTE+64,pressed);
+}
+
+void host_midiIn(const uint8_t * data, uint32_t size)
+{
+	uint8_t * buf;
+	uint32_t pending;
+
+	// keep unread bytes, append the new ones
+
+	pending=host.midiInSize-host.midiInPos;
+	buf=malloc(pending+size);
+	if(pending)
+		memcpy(buf,&host.midiIn[host.midiInPos],pending);
+	memcpy(&buf[pending],data,size);
+
+	free(host.midiIn);
+	host.midiIn=buf;
+	host.midiInSize=pending+size;
+	host.midiInPos=0;
+}
+
+int8_t host_loadStorage(const char * fileName)
+{
+	FILE * f;
+	size_t size;
+
+	f=fopen(fileName,"rb");
+	if(!f)
+		return 0;
+
+	size=fread(storageImage,1,sizeof(storageImage),f);
+	fclose(f);
+
+	return size==sizeof(storageImage);
+}
+
+int8_t host_saveStorage(const char * fileName)
+{
+	FILE * f;
+	size_t size;
+
+	storage_flush();
+
+	f=fopen(fileName,"wb");
+	if(!f)
+		return 0;
+
+	size=fwrite(storageImage,1,sizeof(storageImage),f);
+	fclose(f);
+
+	return size==sizeof(storageImage);
+}
+
+uint32_t host_countEvents(hostEventType_t type, int16_t index, uint64_t fromCycle)
+{
+	uint32_t i,first,count=0;
+	struct hostEvent_s * e;
+
+	first=(host.logCount>HOST_LOG_SIZE)?host.logCount-HOST_LOG_SIZE:0;
+
+	for(i=first;i<host.logCount;++i)
+	{
+		e=&host.log[i%HOST_LOG_SIZE];
+		if(e->type==type && (index<0 || e->index==index) && e->cycle>=fromCycle)
+			++count;
+	}
+
+	return count;
+}
+
+uint64_t host_findEvent(hostEventType_t type, int16_t index, uint64_t fromCycle)
+{
+	uint32_t i,first;
+	struct hostEvent_s * e;
+
+	first=(host.logCount>HOST_LOG_SIZE)?host.logCount-HOST_LOG_SIZE:0;
+
+	for(i=first;i<host.logCount;++i)
+	{
+		e=&host.log[i%HOST_LOG_SIZE];
+		if(e->type==type && (index<0 || e->index==index) && e->cycle>=fromCycle)
+			return e->cycle;
+	}
+
+	return 0;
+}
+
+uint32_t host_getMidiOut(uint8_t * buf, uint32_t maxSize, uint64_t fromCycle)
+{
+	uint32_t i,first,size=0;
+	struct hostEvent_s * e;
+
+	first=(host.logCount>HOST_LOG_SIZE)?host.logCount-HOST_LOG_SIZE:0;
+
+	for(i=first;i<host.logCount && size<maxSize;++i)
+	{
+		e=&host.log[i%HOST_LOG_SIZE];
+		if(e->type==hevMidiOut && e->cycle>=fromCycle)
+			buf[size++]=e->value;
+	}
+
+	return size;
+}
+
+double host_cyclesToMs(uint64_t cycles)
+{
+	return cycles*1000.0/HOST_CPU_HZ;
+}
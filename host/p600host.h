@@ -0,0 +1,98 @@
+#ifndef P600HOST_H
+#define	P600HOST_H
+
+#include <stdio.h>
+
+#include "synth.h"
+
+////////////////////////////////////////////////////////////////////////////////
+// Virtual P600: runs common/ against a recording mockup of hardware.h
+////////////////////////////////////////////////////////////////////////////////
+
+#define HOST_CPU_HZ 16000000UL // virtual AVR clock, all times are in those cycles
+#define HOST_TIMER_CYCLES (HOST_CPU_HZ/2000) // synth_timerInterrupt rate
+#define HOST_BUS_CYCLES 16 // cost of one mem/io access on the real board
+#define HOST_MIDI_BYTE_CYCLES (HOST_CPU_HZ/3125) // 31250 bauds, 10 bits per byte
+#define HOST_STORAGE_READ_CYCLES (HOST_CPU_HZ/1000*21) // one page, bit banged I2C at ~50KHz
+#define HOST_STORAGE_WRITE_CYCLES (HOST_CPU_HZ/1000*48) // one page, including the two 5ms write cycles
+
+#define HOST_LOG_SIZE 65536 // events kept in memory, older ones are overwritten
+
+typedef enum
+{
+	hevDAC=0,		// value: 16 bit DAC value
+	hevCV=1,		// index: p600CV_t, value: DAC value latched into the S&H
+	hevGate=2,		// value: gate bits (p600Gate_t)
+	hevDisplay=3,	// index: display column, value: LED/segment bits
+	hevMidiOut=4,	// value: byte sent by the 6850
+	hevTick=5,		// value: synth_timerInterrupt count
+} hostEventType_t;
+
+struct hostEvent_s
+{
+	uint64_t cycle;
+	uint8_t type;
+	uint8_t index;
+	uint16_t value;
+};
+
+struct host_s
+{
+	uint64_t cycle;
+	uint64_t nextTimer;
+	uint64_t nextMidiIn;
+	uint64_t nextMidiOut; // 6850 transmit register is empty from then on
+
+	uint32_t ticks;
+	uint32_t missedTicks;
+	uint32_t busAccesses;
+	uint32_t midiOutBytes;
+	uint32_t midiOutOverruns; // bytes written while the transmit register was busy
+
+	int8_t storageLatency; // storage_read/write take as long as on the board
+	uint32_t storageReads;
+	uint32_t storageWrites;
+	uint32_t lastStorageWrite; // page index
+
+	uint8_t * midiIn;
+	uint32_t midiInSize,midiInPos;
+
+	uint16_t pots[32];
+	uint8_t keyRows[16];
+	uint8_t bitInputs;
+	uint8_t uartControl;
+
+	uint16_t dac;
+	uint8_t scanRow;
+	uint8_t displayCol;
+	uint8_t displayRows[3];
+	uint8_t gates;
+	uint16_t cvs[32];
+	uint32_t cvWrites[32];
+
+	struct hostEvent_s log[HOST_LOG_SIZE];
+	uint32_t logCount;
+	FILE * logFile;
+};
+
+extern struct host_s host;
+
+void host_init(FILE * logFile);
+void host_logAll(int8_t all);
+void host_boot(void);
+void host_run(uint64_t cycles);
+
+void host_setPot(p600Pot_t pot, uint16_t value);
+void host_setButton(p600Button_t button, int8_t pressed);
+void host_setKey(uint8_t note, int8_t pressed);
+void host_midiIn(const uint8_t * data, uint32_t size);
+
+int8_t host_loadStorage(const char * fileName);
+int8_t host_saveStorage(const char * fileName);
+
+uint32_t host_countEvents(hostEventType_t type, int16_t index, uint64_t fromCycle);
+uint64_t host_findEvent(hostEventType_t type, int16_t index, uint64_t fromCycle); // returns the cycle of the first one, 0 if none
+uint32_t host_getMidiOut(uint8_t * buf, uint32_t maxSize, uint64_t fromCycle); // returns size
+double host_cyclesToMs(uint64_t cycles);
+
+#endif	/* P600HOST_H */
@@ -0,0 +1,18 @@
+#ifndef print_h__
+#define print_h__
+
+#include <stdio.h>
+
+// host replacements for firmware/print.h and the bits of avr/pgmspace.h that common/ uses
+
+#define PROGMEM
+#define pgm_read_byte(addr) (*(const uint8_t *)(addr))
+#define pgm_read_word(addr) (*(const uint16_t *)(addr))
+
+#define print(s) fputs((s),stderr)
+#define pchar(c) fputc((c),stderr)
+
+void phex(unsigned char c);
+void phex16(unsigned int i);
+
+#endif
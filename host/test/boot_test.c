@@ -0,0 +1,100 @@
+////////////////////////////////////////////////////////////////////////////////
+// Boots the virtual P600 and checks the basic hardware activity
+////////////////////////////////////////////////////////////////////////////////
+
+#include "test.h"
+#include "../p600host.h"
+#include "sh.h"
+
+#define MS(ms) ((uint64_t)(ms)*(HOST_CPU_HZ/1000))
+
+static uint16_t maxAmpCV(void)
+{
+	uint16_t m=0;
+	int8_t v;
+
+	for(v=0;v<SYNTH_VOICE_COUNT;++v)
+		m=MAX(m,host.cvs[pcAmp1+v]);
+
+	return m;
+}
+
+int main(void)
+{
+	const uint8_t noteOn[]={0x90,60,100};
+	const uint8_t noteOff[]={0x80,60,0};
+	const uint8_t chord[]={0x90,48,100,0x90,52,100,0x90,55,100,0x90,60,100,0x90,64,100,0x90,67,100};
+	const uint8_t chordOff[]={0x80,48,0,0x80,52,0,0x80,55,0,0x80,60,0,0x80,64,0,0x80,67,0};
+	uint64_t start;
+	uint32_t writes,skips,prevSkips;
+
+	host_init(NULL);
+	host_boot();
+
+	// timer runs at 2Khz
+
+	start=host.cycle;
+	host_run(MS(100));
+	CHECK_RANGE(host.ticks,195,205);
+	CHECK(host.missedTicks==0);
+
+	CHECK(host_countEvents(hevDisplay,-1,0)>0);
+	CHECK(maxAmpCV()==0);
+
+	// idle voices are only refreshed every 8th tick
+
+	start=host.cycle;
+	host_run(MS(100));
+
+	for(int8_t cv=pcOsc1A;cv<=pcAmp6;++cv)
+		CHECK_RANGE(host_countEvents(hevCV,cv,start),24,26);
+
+	// playing voices are refreshed on each tick, but unchanged CVs are only rewritten every 4ms
+
+	host_midiIn(chord,sizeof(chord));
+	host_run(MS(10));
+	sh_getStats(&writes,&skips);
+	start=host.cycle;
+	host_run(MS(100));
+
+	for(int8_t cv=pcOsc1A;cv<=pcAmp6;++cv)
+		CHECK(host_countEvents(hevCV,cv,start)>=24);
+
+	prevSkips=skips;
+	sh_getStats(&writes,&skips);
+	CHECK(skips-prevSkips>=24*150);
+
+	host_midiIn(chordOff,sizeof(chordOff));
+	host_run(MS(1000));
+	CHECK(maxAmpCV()==0);
+
+	// MIDI note on opens a VCA, note off closes it again
+
+	host_midiIn(noteOn,sizeof(noteOn));
+	host_run(MS(50));
+	CHECK(maxAmpCV()>HALF_RANGE);
+
+	host_midiIn(noteOff,sizeof(noteOff));
+	host_run(MS(500));
+	CHECK(maxAmpCV()==0);
+
+	// keyboard is echoed to MIDI out
+
+	start=host.cycle;
+	host_setKey(60,1);
+	host_run(MS(50));
+	CHECK(host_countEvents(hevMidiOut,-1,start)==3);
+	CHECK(maxAmpCV()>HALF_RANGE);
+
+	host_setKey(60,0);
+	host_run(MS(50));
+#ifdef MIDI_RUNNING_STATUS
+	CHECK(host_countEvents(hevMidiOut,-1,start)==5); // note off is a note on under running status
+#else
+	CHECK(host_countEvents(hevMidiOut,-1,start)==6);
+#endif
+
+	printf("boot_test: %u ticks, %u bus accesses\n",host.ticks,host.busAccesses);
+
+	return 0;
+}
@@ -0,0 +1,126 @@
+////////////////////////////////////////////////////////////////////////////////
+// Checks the SPSC byte queue, and benchmarks it against xnormidi's bytequeue
+////////////////////////////////////////////////////////////////////////////////
+
+#include <time.h>
+
+#include "test.h"
+#include "../../xnormidi/bytequeue/bytequeue.h"
+#include "../../xnormidi/bytequeue/spscqueue.h"
+
+#define BENCH_BYTES 50000000L
+#define BENCH_BURST 64 // bytes written between each read, a bit more than a timer tick worth of MIDI input
+
+static uint8_t data[256];
+static volatile uint8_t sink;
+
+static double now(void)
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC,&ts);
+	return ts.tv_sec+ts.tv_nsec*1e-9;
+}
+
+// the way midi_device_process() reads them
+
+static double benchBytequeue(void)
+{
+	byteQueue_t q;
+	byteQueueIndex_t len,i;
+	long n;
+	double t;
+
+	bytequeue_init(&q,data,192);
+
+	t=now();
+	for(n=0;n<BENCH_BYTES;n+=BENCH_BURST)
+	{
+		for(i=0;i<BENCH_BURST;++i)
+			bytequeue_enqueue(&q,i);
+
+		len=bytequeue_length(&q);
+		for(i=0;i<len;++i)
+		{
+			sink=bytequeue_get(&q,0);
+			bytequeue_remove(&q,1);
+		}
+	}
+
+	return BENCH_BYTES/(now()-t);
+}
+
+static double benchSpscqueue(void)
+{
+	spscQueue_t q;
+	spscQueueIndex_t len,i;
+	long n;
+	double t;
+
+	spscqueue_init(&q,data,256);
+
+	t=now();
+	for(n=0;n<BENCH_BYTES;n+=BENCH_BURST)
+	{
+		for(i=0;i<BENCH_BURST;++i)
+			spscqueue_enqueue(&q,i);
+
+		len=spscqueue_length(&q);
+		for(i=0;i<len;++i)
+		{
+			sink=spscqueue_get(&q,0);
+			spscqueue_remove(&q,1);
+		}
+	}
+
+	return BENCH_BYTES/(now()-t);
+}
+
+int main(void)
+{
+	spscQueue_t q;
+	int16_t i,j;
+	uint8_t expected=0,next=0;
+	double old,new;
+
+	// sizes
+
+	CHECK(!spscqueue_init(&q,data,192));
+	CHECK(!spscqueue_init(&q,data,512));
+	CHECK(spscqueue_init(&q,data,16));
+
+	// holds size - 1 bytes
+
+	CHECK(spscqueue_length(&q)==0);
+	for(i=0;i<15;++i)
+		CHECK(spscqueue_enqueue(&q,i));
+	CHECK(!spscqueue_enqueue(&q,15));
+	CHECK(spscqueue_length(&q)==15);
+
+	for(i=0;i<15;++i)
+		CHECK(spscqueue_get(&q,i)==i);
+	spscqueue_remove(&q,15);
+	CHECK(spscqueue_length(&q)==0);
+
+	// wraps around in order, with 8 bit indices at their limit
+
+	CHECK(spscqueue_init(&q,data,256));
+	for(i=0;i<1000;++i)
+	{
+		for(j=0;j<(i%255)+1;++j)
+			CHECK(spscqueue_enqueue(&q,next++));
+		CHECK(spscqueue_length(&q)==(i%255)+1);
+
+		while(spscqueue_length(&q))
+		{
+			CHECK(spscqueue_get(&q,0)==expected++);
+			spscqueue_remove(&q,1);
+		}
+	}
+
+	old=benchBytequeue();
+	new=benchSpscqueue();
+
+	printf("bytequeue_test: bytequeue %.1f MB/s, spscqueue %.1f MB/s (x%.2f)\n",old*1e-6,new*1e-6,new/old);
+
+	return 0;
+}
@@ -0,0 +1,106 @@
+////////////////////////////////////////////////////////////////////////////////
+// Replays a dense MIDI CC stream, checks parameter refreshes are coalesced
+////////////////////////////////////////////////////////////////////////////////
+
+#include <time.h>
+
+#include "test.h"
+#include "../p600host.h"
+#include "storage.h"
+
+#define MS(ms) ((uint64_t)(ms)*(HOST_CPU_HZ/1000))
+
+#define CC_COUNT 1500 // about 1.5s at the wire rate, with running status
+#define MIDI_BASE_STEPPED_CC 48
+#define MIDI_BASE_COARSE_CC 16
+
+extern void refreshFullState(void);
+
+static double now(void)
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC,&ts);
+	return ts.tv_sec+ts.tv_nsec*1e-9;
+}
+
+int main(void)
+{
+	static uint8_t stream[2*CC_COUNT+16];
+	uint32_t size=0,requests,refreshes,i;
+	double t,streamTime,fullTime;
+
+	host_init(NULL);
+	host_boot();
+
+	settings.presetMode=1;
+	host_run(MS(100));
+
+	// a DAW automating cutoff & amp attack, then toggling osc B saw, ending on
+
+	stream[size++]=0xb0;
+	for(i=0;i<CC_COUNT;++i)
+	{
+		if(i<CC_COUNT-8)
+		{
+			stream[size++]=MIDI_BASE_COARSE_CC+((i&1)?cpAmpAtt:cpCutoff);
+			stream[size++]=(i>>1)&0x7f;
+		}
+		else
+		{
+			stream[size++]=MIDI_BASE_STEPPED_CC+spBSaw;
+			stream[size++]=(i&1)?0x7f:0;
+		}
+	}
+
+	CHECK((host.gates&(1<<pgBSaw))==0);
+
+	synth_resetRefreshStats();
+	host_midiIn(stream,size);
+
+	t=now();
+	host_run(size*HOST_MIDI_BYTE_CYCLES+MS(50));
+	streamTime=now()-t;
+
+	synth_getRefreshStats(&requests,&refreshes);
+
+	// the last value of each parameter made it
+
+	CHECK((currentPreset.continuousParameters[cpCutoff]>>9)==(((CC_COUNT-10)>>1)&0x7f));
+	CHECK((currentPreset.continuousParameters[cpAmpAtt]>>9)==(((CC_COUNT-9)>>1)&0x7f));
+	CHECK(currentPreset.steppedParameters[spBSaw]==1);
+	CHECK(host.gates&(1<<pgBSaw));
+
+	// only CCs that changed something are requests, at most one refresh per synth_update,
+	// which runs about every 2ms: ~3 CCs each on the wire
+
+	CHECK(requests>=CC_COUNT/2);
+	CHECK(requests<=CC_COUNT);
+	CHECK(refreshes>0);
+	CHECK(refreshes*2<requests);
+
+	// what it used to cost, one full refresh per CC
+
+	t=now();
+	for(i=0;i<requests;++i)
+		refreshFullState();
+	fullTime=now()-t;
+
+	printf("ccstream_test: %u requests, %u refreshes (%.1f%% coalesced), replay %.1f ms, full refresh per CC alone %.1f ms\n",
+			requests,refreshes,100.0-100.0*refreshes/requests,streamTime*1e3,fullTime*1e3);
+
+	// a single CC is applied by the next update
+
+	synth_resetRefreshStats();
+	stream[0]=0xb0;
+	stream[1]=MIDI_BASE_STEPPED_CC+spBSaw;
+	stream[2]=0;
+	host_midiIn(stream,3);
+	host_run(MS(10));
+
+	synth_getRefreshStats(&requests,&refreshes);
+	CHECK(requests==1);
+	CHECK(refreshes==1);
+	CHECK((host.gates&(1<<pgBSaw))==0);
+
+	return 0;
+}
@@ -0,0 +1,76 @@
+////////////////////////////////////////////////////////////////////////////////
+// Checks the jitter between incoming MIDI clock and arpeggiator steps
+////////////////////////////////////////////////////////////////////////////////
+
+#include "test.h"
+#include "../p600host.h"
+#include "storage.h"
+#include "arp.h"
+
+#define MS(ms) ((uint64_t)(ms)*(HOST_CPU_HZ/1000))
+
+#define CLOCKS_PER_STEP 6 // extClockDividers[12]
+#define STEP_COUNT 48
+
+int main(void)
+{
+	const uint8_t start[]={0xfa};
+	const uint8_t clock[]={0xf8};
+	uint64_t t,period,out,delay,minDelay=UINT64_MAX,maxDelay=0;
+	int16_t step,c;
+
+	host_init(NULL);
+	host_boot();
+
+	// arp on two held keys, synced to MIDI clock
+
+	settings.syncMode=smMIDI;
+	settings.seqArpClock=12*4096+2048;
+	arp_setMode(amUpDown,1);
+	host_run(MS(100));
+	host_setKey(60,1);
+	host_setKey(64,1);
+	host_run(MS(100));
+
+	// 24ppq at a tempo that drifts against the 2Khz timer, ~124bpm
+
+	period=HOST_CPU_HZ*60/(124*24)+17;
+
+	host_midiIn(start,sizeof(start));
+	host_run(MS(5));
+
+	t=host.cycle;
+	for(step=0;step<STEP_COUNT;++step)
+	{
+		for(c=0;c<CLOCKS_PER_STEP;++c)
+		{
+			host_run(t-host.cycle);
+			host_midiIn(clock,sizeof(clock));
+			t+=period;
+
+			// the step is taken on the first clock of each group
+
+			if(c==0)
+			{
+				host_run(MS(5));
+				out=host_findEvent(hevMidiOut,-1,t-period);
+				CHECK(out>0);
+
+				delay=out-(t-period);
+				minDelay=MIN(minDelay,delay);
+				maxDelay=MAX(maxDelay,delay);
+			}
+		}
+	}
+
+	printf("clocksync_test: clock to step delay %.3f to %.3f ms, jitter %.3f ms\n",
+			host_cyclesToMs(minDelay),host_cyclesToMs(maxDelay),host_cyclesToMs(maxDelay-minDelay));
+
+	// it used to be up to 2.5ms (phase 0 parsing, then phase 1 clock), steps now follow the
+	// tempo tracker, aimed 1ms after the clock
+
+	CHECK(host_cyclesToMs(maxDelay-minDelay)<=1.0);
+	CHECK(host_cyclesToMs(maxDelay)<=1.5);
+
+	return 0;
+}
@@ -0,0 +1,221 @@
+////////////////////////////////////////////////////////////////////////////////
+// Checks the background bulk preset dump, while the synth is played
+////////////////////////////////////////////////////////////////////////////////
+
+#include "test.h"
+#include "../p600host.h"
+#include "storage.h"
+#include "midi.h"
+#include "assigner.h"
+
+#define MS(ms) ((uint64_t)(ms)*(HOST_CPU_HZ/1000))
+
+#define DUMPED_COUNT 3
+#define BURST_NOTES 24 // 144 bytes of note on/off, more than the send queue has room for next to a dump sysex (see midi.c)
+
+static const uint8_t presetNumbers[DUMPED_COUNT]={3,10,42};
+
+struct note_s
+{
+	uint8_t status,note,velocity;
+};
+
+// undoes the 4+1 scrambling of sysexSend()
+static int16_t descramble(const uint8_t * in, int16_t size, uint8_t * out)
+{
+	int16_t i,j,n=0;
+
+	for(i=0;i+5<=size;i+=5)
+		for(j=0;j<4;++j)
+			out[n++]=in[i+j]|(((in[i+4]>>j)&1)<<7);
+
+	return n;
+}
+
+// whole messages only, the dumps are the exported presets, returns the note on/off messages around them
+static int16_t parse(const uint8_t * out, uint32_t size, struct note_s * notes, int16_t maxNotes)
+{
+	static uint8_t decoded[512],exported[512];
+	uint32_t i,sysexStart=0;
+	int16_t exportedSize,decodedSize,dumps=0,noteCount=0;
+	uint8_t status=0,data[2],dataCount=0;
+	int8_t inSysex=0;
+
+	for(i=0;i<size;++i)
+	{
+		if(out[i]==0xf0)
+		{
+			CHECK(!inSysex);
+			inSysex=1;
+			sysexStart=i;
+		}
+		else if(out[i]==0xf7)
+		{
+			CHECK(inSysex);
+			inSysex=0;
+
+			CHECK(dumps<DUMPED_COUNT);
+			CHECK(out[sysexStart+4]==SYSEX_COMMAND_PATCH_DUMP);
+
+			decodedSize=descramble(&out[sysexStart+5],i-sysexStart-5,decoded);
+			storage_export(presetNumbers[dumps],exported,&exportedSize);
+
+			CHECK(decoded[0]==presetNumbers[dumps]);
+			CHECK(decodedSize>=exportedSize && decodedSize<exportedSize+4);
+			CHECK(!memcmp(decoded,exported,exportedSize));
+			++dumps;
+		}
+		else if(inSysex)
+		{
+			CHECK(out[i]<0x80);
+		}
+		else if(out[i]&0x80)
+		{
+			status=out[i];
+			dataCount=0;
+		}
+		else
+		{
+			data[dataCount++]=out[i];
+			if(dataCount<2)
+				continue;
+			dataCount=0;
+
+			if((status&0xe0)==0x80 && noteCount<maxNotes) // note on/off
+				notes[noteCount++]=(struct note_s){status,data[0],data[1]};
+		}
+	}
+
+	CHECK(!inSysex);
+	CHECK(dumps==DUMPED_COUNT);
+
+	return noteCount;
+}
+
+// the host event log only holds a few ms, read it as we go, with what was sent in between
+static uint64_t collected;
+
+static uint32_t collect(uint64_t cycles, uint8_t * buf, uint32_t maxSize)
+{
+	uint64_t end=host.cycle+cycles;
+	uint32_t size=0;
+
+	while(host.cycle<end)
+	{
+		host_run(MIN(MS(5),end-host.cycle));
+		size+=host_getMidiOut(&buf[size],maxSize-size,collected);
+		collected=host.cycle;
+	}
+
+	return size;
+}
+
+int main(void)
+{
+	static uint8_t out[8192];
+	static struct preset_s savedPreset;
+	static struct note_s notes[2*BURST_NOTES+8],sent[2*BURST_NOTES];
+	uint64_t start,keyDown=0,keyPlayed=0;
+	uint64_t chunk;
+	uint32_t size=0,i;
+	int16_t noteCount,noteOn=-1,noteOff=-1,sentCount=0;
+
+	host_init(NULL);
+	host_boot();
+	host_run(MS(100));
+
+	for(i=0;i<DUMPED_COUNT;++i)
+	{
+		currentPreset.continuousParameters[cpCutoff]=0x1000*(i+1);
+		preset_saveCurrent(presetNumbers[i]);
+	}
+
+	currentPreset.continuousParameters[cpCutoff]=12345;
+	savedPreset=currentPreset;
+
+	// dump while a note is played
+
+	midi_dumpPresets();
+
+	start=host.cycle;
+	while(host.cycle<start+MS(1500))
+	{
+		if(!keyDown && host.cycle>=start+MS(50))
+		{
+			host_setKey(60,1);
+			keyDown=host.cycle;
+		}
+		else if(keyDown && host.cycle>=keyDown+MS(200))
+		{
+			host_setKey(60,0);
+		}
+
+		chunk=host.cycle;
+		host_run(MS(5));
+		size+=host_getMidiOut(&out[size],sizeof(out)-size,chunk);
+
+		if(keyDown && !keyPlayed && assigner_getAnyPressed())
+			keyPlayed=host.cycle;
+	}
+
+	// the synth still plays
+
+	CHECK(keyPlayed && keyPlayed-keyDown<=MS(20));
+
+	// notes come between the sysexes, each is queued whole
+
+	noteCount=parse(out,size,notes,sizeof(notes)/sizeof(notes[0]));
+
+	for(i=0;i<noteCount;++i)
+	{
+		if(notes[i].note!=60)
+			continue;
+
+		if(notes[i].status==0x90 && notes[i].velocity)
+			noteOn=i;
+		else // note on with velocity 0 under running status
+			noteOff=i;
+	}
+
+	CHECK(noteOn>=0 && noteOff>noteOn);
+
+	// the current preset wasn't touched
+
+	CHECK(!memcmp(&savedPreset,&currentPreset,sizeof(currentPreset)));
+
+	printf("dumpbank_test: %d presets in %u bytes, with a note in between\n",DUMPED_COUNT,size);
+
+	// chords played during a dump, more than there is room for: the senders wait for the UART, no note is lost
+
+	size=0;
+	collected=host.cycle;
+	midi_dumpPresets();
+	size+=collect(MS(2),&out[size],sizeof(out)-size);
+
+	for(i=0;i<2*BURST_NOTES;++i)
+	{
+		midi_sendNoteEvent(48+(i>>1),!(i&1),HALF_RANGE);
+#ifdef MIDI_RUNNING_STATUS
+		sent[sentCount++]=(struct note_s){0x90|settings.midiSendChannel,48+(i>>1),(i&1)?0:64};
+#else
+		sent[sentCount++]=(struct note_s){((i&1)?0x80:0x90)|settings.midiSendChannel,48+(i>>1),64};
+#endif
+		size+=collect(MS(1)/2,&out[size],sizeof(out)-size);
+	}
+
+	size+=collect(MS(1500),&out[size],sizeof(out)-size);
+	noteCount=parse(out,size,notes,sizeof(notes)/sizeof(notes[0]));
+
+	CHECK(noteCount==sentCount);
+	for(i=0;i<sentCount;++i)
+	{
+		CHECK(notes[i].status==sent[i].status);
+		CHECK(notes[i].note==sent[i].note);
+		CHECK(notes[i].velocity==sent[i].velocity);
+	}
+
+	printf("dumpbank_test: %d presets with %d note messages played over them, %d received in order\n",
+			DUMPED_COUNT,sentCount,noteCount);
+
+	return 0;
+}
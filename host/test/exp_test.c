@@ -0,0 +1,73 @@
+////////////////////////////////////////////////////////////////////////////////
+// Checks the fixed point exponentials against their float reference
+////////////////////////////////////////////////////////////////////////////////
+
+#include "test.h"
+#include "utils.h"
+
+static double maxRelError,maxAbsError;
+
+// slack: absolute error coming from the 16 bit mantissa
+static void compare(double ref, double value, double slack)
+{
+	double err=fabs(value-ref);
+
+	// 1 LSB of truncation is allowed on top of the relative error
+	if(err>1.0+slack && ref>0.0)
+		maxRelError=MAX(maxRelError,(err-1.0-slack)/ref);
+	maxAbsError=MAX(maxAbsError,err);
+
+	CHECK(err<=1.0+slack+ref*0.0005);
+}
+
+static void checkCourse(double ratio, uint32_t coef, uint16_t range)
+{
+	uint32_t v;
+
+	for(v=0;v<=UINT16_MAX;++v)
+		compare(exp(-(double)v/ratio)*range,exponentialCourse(v,coef,range),0.0);
+}
+
+static void checkRise(double ratio, uint32_t coef, uint16_t scale)
+{
+	uint32_t v;
+
+	for(v=0;v<=UINT16_MAX;++v)
+		compare(MIN((exp((double)v/ratio)-1.0)*scale,UINT16_MAX),exponentialRise(v,coef,scale),scale/65536.0);
+}
+
+int main(void)
+{
+	int32_t x;
+
+	// raw exp2, over the useful range
+
+	for(x=-16*65536;x<15*65536;x+=97)
+	{
+		double ref=pow(2.0,x/65536.0)*65536.0;
+		double err=fabs(exp2Fixed(x)-ref);
+
+		CHECK(err<=1.0+ref*2e-5);
+	}
+
+	CHECK(exp2Fixed(0)==65536);
+	CHECK(exp2Fixed(65536)==131072);
+	CHECK(exp2Fixed(-65536)==32768);
+	CHECK(exp2Fixed(16*65536)==UINT32_MAX);
+	CHECK(exp2Fixed(-18*65536)==0);
+
+	// every call site in common/
+
+	checkCourse(22000.0,EXP_COEF(22000),500);		// clock speed
+	checkCourse(8000.0,EXP_COEF(8000),65535);		// lfo speed
+	checkCourse(12000.0,EXP_COEF(12000),2500);		// modulation delay
+	checkCourse(11000.0,EXP_COEF(11000),2100);		// glide
+	checkRise(15000.0,EXP_COEF(15000),870);			// lfo & vibrato amount
+	checkRise(30000.0,EXP_COEF(30000),8310);		// modwheel
+	checkRise(17000.0,EXP_COEF(17000),1418);
+	checkRise(14000.0,EXP_COEF(14000),613);
+
+	printf("exp_test: max error %.3f LSB, %.4f%% above 1 LSB\n",maxAbsError,maxRelError*100.0);
+
+	return 0;
+}
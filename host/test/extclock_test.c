@@ -0,0 +1,150 @@
+////////////////////////////////////////////////////////////////////////////////
+// Checks the external clock tempo tracker on jittered MIDI clock streams
+////////////////////////////////////////////////////////////////////////////////
+
+#include <math.h>
+
+#include "test.h"
+#include "../p600host.h"
+#include "storage.h"
+#include "arp.h"
+#include "extclock.h"
+
+#define MS(ms) ((uint64_t)(ms)*(HOST_CPU_HZ/1000))
+
+#define CLOCKS_PER_STEP 6 // extClockDividers[12]
+#define CLOCKS_PER_TEMPO 144
+#define SETTLE_CLOCKS 24
+#define JITTER_US 1500 // +/-, uniform
+
+struct stats_s
+{
+	double sum,sumSq,min,max;
+	int16_t count;
+};
+
+static uint32_t randomState=12345;
+
+static int32_t jitter(void)
+{
+	randomState=randomState*1103515245+12345;
+	return (int32_t)((randomState>>8)%(2*JITTER_US+1))-JITTER_US;
+}
+
+static void addStat(struct stats_s * s, double v)
+{
+	if(!s->count || v<s->min)
+		s->min=v;
+	if(!s->count || v>s->max)
+		s->max=v;
+	s->sum+=v;
+	s->sumSq+=v*v;
+	++s->count;
+}
+
+static double deviation(struct stats_s * s)
+{
+	double mean=s->sum/s->count;
+	return sqrt(s->sumSq/s->count-mean*mean);
+}
+
+// one tempo, returns the BPM estimate at the end
+static uint16_t runTempo(uint64_t * ideal, uint16_t bpm, struct stats_s * in, struct stats_s * out)
+{
+	const uint8_t clock[]={0xf8};
+	uint64_t period,arrival,step;
+	int16_t c;
+
+	period=HOST_CPU_HZ*60/(bpm*24);
+
+	for(c=0;c<CLOCKS_PER_TEMPO;++c)
+	{
+		*ideal+=period;
+		arrival=*ideal+(int64_t)jitter()*(HOST_CPU_HZ/1000000);
+
+		host_run(arrival-host.cycle);
+		host_midiIn(clock,sizeof(clock));
+
+		if(c%CLOCKS_PER_STEP==0)
+		{
+			host_run(MS(8));
+			step=host_findEvent(hevMidiOut,-1,arrival-MS(1));
+
+			// steps are never taken ahead of the master
+
+			CHECK(step>=arrival);
+			CHECK(step<arrival+MS(8));
+
+			if(c>=SETTLE_CLOCKS)
+			{
+				addStat(in,host_cyclesToMs(arrival)-host_cyclesToMs(*ideal));
+				addStat(out,host_cyclesToMs(step)-host_cyclesToMs(*ideal));
+			}
+		}
+	}
+
+	return extclock_getBPM();
+}
+
+int main(void)
+{
+	const uint8_t start[]={0xfa};
+	struct stats_s in={0},out={0};
+	uint64_t ideal;
+	uint16_t bpm;
+	int16_t c;
+
+	host_init(NULL);
+	host_boot();
+
+	// arp on two held keys, synced to MIDI clock
+
+	settings.syncMode=smMIDI;
+	settings.seqArpClock=12*4096+2048;
+	arp_setMode(amUpDown,1);
+	host_run(MS(100));
+	host_setKey(60,1);
+	host_setKey(64,1);
+	host_run(MS(100));
+
+	host_midiIn(start,sizeof(start));
+	host_run(MS(5));
+	CHECK(extclock_getBPM()==0);
+
+	// a tempo change, then a slow one
+
+	ideal=host.cycle;
+
+	bpm=runTempo(&ideal,124,&in,&out);
+	printf("extclock_test: 124 bpm estimated at %u\n",bpm);
+	CHECK(bpm>=123 && bpm<=125);
+
+	bpm=runTempo(&ideal,140,&in,&out);
+	printf("extclock_test: 140 bpm estimated at %u\n",bpm);
+	CHECK(bpm>=139 && bpm<=141);
+
+	bpm=runTempo(&ideal,72,&in,&out);
+	printf("extclock_test: 72 bpm estimated at %u\n",bpm);
+	CHECK(bpm>=71 && bpm<=73);
+
+	// the smoothed phase takes out part of the clock jitter
+
+	printf("extclock_test: clock jitter %.3f ms (%.3f dev), step jitter %.3f ms (%.3f dev)\n",
+			in.max-in.min,deviation(&in),out.max-out.min,deviation(&out));
+
+	CHECK(deviation(&out)<deviation(&in)*0.65);
+	CHECK(out.max-out.min<(in.max-in.min)*0.8);
+
+	// when the master stops, so do the steps
+
+	host_run(MS(100));
+	for(c=0;c<80;++c)
+	{
+		ideal=host.cycle;
+		host_run(MS(5));
+		CHECK(host_findEvent(hevMidiOut,-1,ideal)==0);
+	}
+	CHECK(extclock_getBPM()==0);
+
+	return 0;
+}
@@ -0,0 +1,66 @@
+////////////////////////////////////////////////////////////////////////////////
+// Checks that MIDI out runs at wire rate, fed from the UART interrupt
+////////////////////////////////////////////////////////////////////////////////
+
+#include "test.h"
+#include "../p600host.h"
+#include "midi.h"
+
+#define MS(ms) ((uint64_t)(ms)*(HOST_CPU_HZ/1000))
+
+int main(void)
+{
+	const uint8_t request[]={0xf0,SYSEX_ID_0,SYSEX_ID_1,SYSEX_ID_2,SYSEX_COMMAND_PROFILER_REQUEST,0,0xf7};
+	uint8_t out[256];
+	uint32_t size,bytes,prev;
+	uint64_t start,last;
+	uint8_t highWater;
+	uint16_t overflows;
+	double rate;
+	int8_t i;
+
+	host_init(NULL);
+	host_boot();
+	host_run(MS(100));
+	midi_resetSendStats();
+
+	// a burst of profiler dumps, much more than the send queue holds
+
+	for(i=0;i<16;++i)
+		host_midiIn(request,sizeof(request));
+
+	// poll, the host event log doesn't hold that much
+
+	start=host.cycle;
+	last=start;
+	bytes=host.midiOutBytes;
+	for(i=0;i<100;++i)
+	{
+		prev=host.midiOutBytes;
+		host_run(MS(20));
+		if(host.midiOutBytes!=prev)
+			last=host.cycle;
+
+		if(!i)
+		{
+			CHECK(host_getMidiOut(out,sizeof(out),start)>0);
+			CHECK(out[0]==0xf0);
+		}
+	}
+	size=host.midiOutBytes-bytes;
+	CHECK(size>1000);
+
+	// the last byte went out at about the wire rate
+
+	rate=size/(host_cyclesToMs(last-start)/1000.0);
+	CHECK(rate>2500.0);
+	CHECK(host.midiOutOverruns==0);
+
+	midi_getSendStats(&highWater,&overflows);
+	CHECK(highWater>32);
+	CHECK(overflows>0);
+
+	fprintf(stderr,"midiout_test: %u bytes at %.0f bytes/s, queue high water %u, %u overflows\n",size,rate,highWater,overflows);
+
+	return 0;
+}
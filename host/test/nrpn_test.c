@@ -0,0 +1,246 @@
+////////////////////////////////////////////////////////////////////////////////
+// Checks NRPN parameter changes, parameter snapshot sysex & NRPN panel transmit
+////////////////////////////////////////////////////////////////////////////////
+
+#include "test.h"
+#include "../p600host.h"
+#include "storage.h"
+
+#define MS(ms) ((uint64_t)(ms)*(HOST_CPU_HZ/1000))
+
+#define MIDI_BASE_FINE_CC 80
+
+static void cc(uint8_t control, uint8_t value)
+{
+	uint8_t msg[3]={0xb0,control,value};
+
+	host_midiIn(msg,sizeof(msg));
+	host_run(3*HOST_MIDI_BYTE_CYCLES);
+}
+
+static void nrpn(uint8_t msb, uint8_t lsb)
+{
+	cc(99,msb);
+	cc(98,lsb);
+}
+
+// the host event log only holds a few ms, read it as we go
+static uint32_t collect(uint64_t cycles, uint8_t * buf, uint32_t maxSize)
+{
+	uint64_t start=host.cycle,end=host.cycle+cycles;
+	uint32_t size=0;
+
+	while(host.cycle<end)
+	{
+		host_run(MIN(MS(5),end-host.cycle));
+		size+=host_getMidiOut(&buf[size],maxSize-size,start);
+		start=host.cycle;
+	}
+
+	return size;
+}
+
+int main(void)
+{
+	static uint8_t buf[4096],snapshot[64],syx[128];
+	uint32_t size,panelSize,i,requests,refreshes,selects=0,n;
+	uint16_t cutoff,lastData=0;
+	int16_t dataMsb=-1;
+	uint8_t status=0xb0; // boot sends controllers already, running status might be on
+
+	host_init(NULL);
+	host_boot();
+	host_run(MS(100));
+
+	// panel moves are sent as NRPN 0/cp, the parameter number only once
+
+	size=0;
+	for(i=0;i<20;++i)
+	{
+		host_setPot(ppCutoff,0x1000+i*0x400);
+		size+=collect(MS(10),&buf[size],sizeof(buf)-size);
+	}
+
+	size+=collect(MS(50),&buf[size],sizeof(buf)-size); // the last move, within the panel budget
+
+	for(i=0;i+1<size;)
+	{
+		if(buf[i]&0x80)
+			status=buf[i++];
+
+		CHECK(status==0xb0);
+
+		if(buf[i]==99)
+		{
+			CHECK(buf[i+1]==0);
+			++selects;
+		}
+		else if(buf[i]==98)
+		{
+			CHECK(buf[i+1]==cpCutoff);
+		}
+		else if(buf[i]==6)
+		{
+			dataMsb=buf[i+1];
+		}
+		else if(buf[i]==38)
+		{
+			CHECK(dataMsb>=0); // right after its msb
+			lastData=(dataMsb<<7)|buf[i+1];
+		}
+		else
+		{
+			CHECK(0);
+		}
+
+		if(buf[i]!=6)
+			dataMsb=-1;
+
+		i+=2;
+	}
+
+	cutoff=currentPreset.continuousParameters[cpCutoff];
+	panelSize=size;
+	CHECK(selects==1);
+	CHECK(lastData==cutoff>>2);
+
+	// in preset mode, NRPN data entry msb & lsb are applied at once
+
+	cc(0,1); // preset mode, pots aren't picked up anymore
+	host_run(MS(20));
+	cutoff=currentPreset.continuousParameters[cpCutoff];
+
+	nrpn(0,cpCutoff);
+	synth_resetRefreshStats();
+	cc(6,0x55);
+	host_run(MS(2));
+	CHECK(currentPreset.continuousParameters[cpCutoff]==cutoff);
+	cc(38,0x2a);
+	host_run(MS(10));
+
+	CHECK(currentPreset.continuousParameters[cpCutoff]==((0x55<<9)|(0x2a<<2)));
+	synth_getRefreshStats(&requests,&refreshes);
+	CHECK(requests==1);
+
+	// the parameter stays selected, an msb alone is applied after a while, like a coarse CC
+
+	cc(6,0x11);
+	host_run(MS(10));
+	CHECK(currentPreset.continuousParameters[cpCutoff]==((0x11<<9)|(0x2a<<2)));
+
+	// or when something else comes in
+
+	cc(6,0x12);
+	cc(MIDI_BASE_FINE_CC+cpResonance,0);
+	host_run(MS(3));
+	CHECK(currentPreset.continuousParameters[cpCutoff]==((0x12<<9)|(0x2a<<2)));
+
+	// CC 38 not following CC 6 is still glide coarse
+
+	cc(38,0x33);
+	host_run(MS(10));
+	CHECK((currentPreset.continuousParameters[cpGlide]>>9)==0x33);
+	CHECK((currentPreset.continuousParameters[cpCutoff]>>9)==0x12);
+
+	// CC 99 & 98 alone are still fine cpPModOscB & cpPModFilEnv, 99 once it's known no 98 follows it
+
+	cc(MIDI_BASE_FINE_CC+cpPModOscB,0x55);
+	host_run(MS(10));
+	CHECK((currentPreset.continuousParameters[cpPModOscB]&0x01fc)==(0x55<<2));
+
+	cc(MIDI_BASE_FINE_CC+cpPModFilEnv,0x2a);
+	host_run(MS(10));
+	CHECK((currentPreset.continuousParameters[cpPModFilEnv]&0x01fc)==(0x2a<<2));
+
+	cc(MIDI_BASE_FINE_CC+cpPModOscB,0x11);
+	cc(MIDI_BASE_FINE_CC+cpResonance,0x22);
+	host_run(MS(3));
+	CHECK((currentPreset.continuousParameters[cpPModOscB]&0x01fc)==(0x11<<2));
+	CHECK((currentPreset.continuousParameters[cpResonance]&0x01fc)==(0x22<<2));
+
+	// the NRPN parameter is still selected
+
+	cc(6,0x13);
+	cc(38,0x01);
+	host_run(MS(10));
+	CHECK(currentPreset.continuousParameters[cpCutoff]==((0x13<<9)|(0x01<<2)));
+
+	// stepped parameters, data entry msb like their CC
+
+	CHECK((host.gates&(1<<pgBSaw))==0);
+	nrpn(1,spBSaw);
+	cc(6,0x7f);
+	cc(38,0);
+	host_run(MS(10));
+	CHECK(currentPreset.steppedParameters[spBSaw]==1);
+	CHECK(host.gates&(1<<pgBSaw));
+
+	// the arp/seq clock is a setting, changed in manual mode too
+
+	settings.presetMode=0;
+	nrpn(0,cpSeqArpClock);
+	cc(6,0x40);
+	cc(38,0x01);
+	host_run(MS(10));
+	CHECK(settings.seqArpClock==((0x40<<9)|(0x01<<2)));
+	settings.presetMode=1;
+
+	// parameter snapshot: a whole set of changes, one refresh
+
+	n=0;
+	snapshot[n++]=6;
+	snapshot[n++]=cpCutoff;
+	snapshot[n++]=0x34;
+	snapshot[n++]=0x12;
+	snapshot[n++]=cpResonance;
+	snapshot[n++]=0xff;
+	snapshot[n++]=0xee;
+	snapshot[n++]=cpAmpAtt;
+	snapshot[n++]=0x00;
+	snapshot[n++]=0x80;
+	snapshot[n++]=0x80|spBSaw;
+	snapshot[n++]=0;
+	snapshot[n++]=0x80|spATri;
+	snapshot[n++]=1;
+	snapshot[n++]=0x80|spLFOShape;
+	snapshot[n++]=2;
+
+	size=0;
+	syx[size++]=0xf0;
+	syx[size++]=SYSEX_ID_0;
+	syx[size++]=SYSEX_ID_1;
+	syx[size++]=SYSEX_ID_2;
+	syx[size++]=SYSEX_COMMAND_PARAMETER_SNAPSHOT;
+	for(i=0;i<n;i+=4)
+	{
+		syx[size++]=snapshot[i]&0x7f;
+		syx[size++]=(i+1<n)?snapshot[i+1]&0x7f:0;
+		syx[size++]=(i+2<n)?snapshot[i+2]&0x7f:0;
+		syx[size++]=(i+3<n)?snapshot[i+3]&0x7f:0;
+		syx[size++]=((snapshot[i]>>7)&1)|((i+1<n)?(snapshot[i+1]>>6)&2:0)|
+				((i+2<n)?(snapshot[i+2]>>5)&4:0)|((i+3<n)?(snapshot[i+3]>>4)&8:0);
+	}
+	syx[size++]=0xf7;
+
+	synth_resetRefreshStats();
+	host_midiIn(syx,size);
+	host_run(size*HOST_MIDI_BYTE_CYCLES+MS(10));
+
+	CHECK(currentPreset.continuousParameters[cpCutoff]==0x1234);
+	CHECK(currentPreset.continuousParameters[cpResonance]==0xeefc); // 2 low bits are always cleared
+	CHECK(currentPreset.continuousParameters[cpAmpAtt]==0x8000);
+	CHECK(currentPreset.steppedParameters[spBSaw]==0);
+	CHECK(currentPreset.steppedParameters[spATri]==1);
+	CHECK(currentPreset.steppedParameters[spLFOShape]==2);
+	CHECK((host.gates&(1<<pgBSaw))==0);
+	CHECK(host.gates&(1<<pgATri));
+
+	synth_getRefreshStats(&requests,&refreshes);
+	CHECK(requests==1);
+	CHECK(refreshes==1);
+
+	printf("nrpn_test: %u bytes for 20 panel moves, snapshot of 6 parameters in %u bytes, 1 refresh\n",
+			panelSize,size);
+
+	return 0;
+}
@@ -0,0 +1,134 @@
+////////////////////////////////////////////////////////////////////////////////
+// Replays a preset recall session against a storage with the board I2C timings,
+// checks the page cache hit rate and its write-back
+////////////////////////////////////////////////////////////////////////////////
+
+#include "test.h"
+#include "../p600host.h"
+#include "storage.h"
+#include "midi.h"
+
+#define MS(ms) ((uint64_t)(ms)*(HOST_CPU_HZ/1000))
+
+#define SESSION_PRESETS 8 // presets 0 to 7, the session only uses those
+
+typedef enum {seProgChange,seDump,seEdit,seSave} sessionEvent_t;
+
+// someone going back and forth between a few programs, editing, storing & sending one
+static const uint8_t session[][2]=
+{
+	{seProgChange,1},{seProgChange,2},{seProgChange,1},{seProgChange,2},
+	{seProgChange,3},{seDump,3},{seProgChange,1},{seProgChange,3},
+	{seEdit,0},{seSave,3},{seProgChange,4},{seProgChange,3},
+	{seDump,3},{seProgChange,5},{seProgChange,6},{seProgChange,5},
+	{seDump,5},{seProgChange,7},{seProgChange,5},{seProgChange,7},
+};
+
+#define SESSION_SIZE (sizeof(session)/sizeof(session[0]))
+
+static void progChange(uint8_t program)
+{
+	uint8_t msg[2]={0xc0,program};
+
+	host_midiIn(msg,sizeof(msg));
+	host_run(2*HOST_MIDI_BYTE_CYCLES+HOST_STORAGE_READ_CYCLES+MS(5));
+}
+
+int main(void)
+{
+	uint32_t i,hits,misses,flushes,reads,writes,loads=0;
+	uint64_t cached,uncached;
+
+	host_init(NULL);
+	host_boot();
+	settings.presetMode=1; // pots don't change the preset under us
+	host_run(MS(100));
+
+	for(i=0;i<SESSION_PRESETS;++i)
+	{
+		currentPreset.continuousParameters[cpCutoff]=0x1000*(i+1);
+		preset_saveCurrent(i);
+	}
+
+	storage_flush();
+
+	// stored presets are written back by the main loop, right away
+
+	writes=host.storageWrites;
+	currentPreset.continuousParameters[cpResonance]=1234;
+	preset_saveCurrent(SESSION_PRESETS-1);
+	CHECK(host.storageWrites==writes);
+	host_run(MS(100));
+	CHECK(host.storageWrites==writes+1);
+
+	// unchanged pages aren't written again
+
+	preset_saveCurrent(SESSION_PRESETS-1);
+	host_run(MS(600));
+	CHECK(host.storageWrites==writes+1);
+
+	// the session, with I2C timings
+
+	settings.presetNumber=0;
+	host.storageLatency=1;
+	storage_resetCacheStats();
+	reads=host.storageReads;
+	writes=host.storageWrites;
+
+	for(i=0;i<SESSION_SIZE;++i)
+	{
+		switch(session[i][0])
+		{
+		case seProgChange:
+			progChange(session[i][1]);
+			CHECK(settings.presetNumber==session[i][1]);
+			CHECK(currentPreset.continuousParameters[cpCutoff]==0x1000*(session[i][1]+1));
+			++loads;
+			break;
+		case seDump:
+			CHECK(midi_dumpPreset(session[i][1]));
+			host_run(MS(100));
+			break;
+		case seEdit:
+			currentPreset.continuousParameters[cpCutoff]=0x1000*(settings.presetNumber+1);
+			currentPreset.continuousParameters[cpResonance]+=0x400;
+			break;
+		case seSave:
+			preset_saveCurrent(session[i][1]);
+			host_run(MS(600));
+			break;
+		}
+	}
+
+	storage_getCacheStats(&hits,&misses,&flushes);
+	reads=host.storageReads-reads;
+	writes=host.storageWrites-writes;
+
+	// going back to the previous program is a hit, dumps only read the page they export
+	// (the directory tells it's there)
+
+	CHECK(reads==misses);
+	CHECK(writes==flushes);
+	CHECK(flushes==1);
+	CHECK(hits+misses>=loads);
+	CHECK(hits*2>=loads);
+
+	cached=reads*HOST_STORAGE_READ_CYCLES+writes*HOST_STORAGE_WRITE_CYCLES;
+	uncached=(hits+misses)*HOST_STORAGE_READ_CYCLES+writes*HOST_STORAGE_WRITE_CYCLES;
+
+	printf("pagecache_test: %u hits, %u misses (%.1f%% hit rate), %u flushes, I2C time %.0f ms instead of %.0f ms\n",
+			hits,misses,100.0*hits/(hits+misses),flushes,host_cyclesToMs(cached),host_cyclesToMs(uncached));
+
+	// what's in the cache is what's in the EEPROM
+
+	host.storageLatency=0;
+	storage_flush();
+
+	for(i=0;i<SESSION_PRESETS;++i)
+	{
+		CHECK(preset_loadCurrent(i,0));
+		CHECK(currentPreset.continuousParameters[cpCutoff]==0x1000*(i+1));
+	}
+
+	return 0;
+}
@@ -0,0 +1,83 @@
+////////////////////////////////////////////////////////////////////////////////
+// Checks panel moves sent to MIDI come back the same when looped into a P600:
+// none of them is taken for an NRPN controller, in NRPN or CC pair mode
+////////////////////////////////////////////////////////////////////////////////
+
+#include "test.h"
+#include "../p600host.h"
+#include "storage.h"
+#include "midi.h"
+
+#define MS(ms) ((uint64_t)(ms)*(HOST_CPU_HZ/1000))
+
+#define MOVE_COUNT 40
+#define POT_BITS 10 // both pots, see potmux.c
+
+// fine CC 98 & 99 in CC pair mode, one right after the other is an NRPN number
+static const continuousParameter_t params[]={cpPModFilEnv,cpPModOscB};
+
+#define POT_COUNT (sizeof(params)/sizeof(params[0]))
+
+// the host event log only holds a few ms, read it as we go, with what was sent in between
+static uint64_t collected;
+
+static uint32_t collect(uint64_t cycles, uint8_t * buf, uint32_t maxSize)
+{
+	uint64_t end=host.cycle+cycles;
+	uint32_t size=0;
+
+	while(host.cycle<end)
+	{
+		host_run(MIN(MS(5),end-host.cycle));
+		size+=host_getMidiOut(&buf[size],maxSize-size,collected);
+		collected=host.cycle;
+	}
+
+	return size;
+}
+
+int main(void)
+{
+	static uint8_t buf[8192];
+	uint16_t sent[POT_COUNT];
+	uint32_t size=0,i,j;
+
+	host_init(NULL);
+	host_boot();
+	host_run(MS(200));
+	collected=host.cycle;
+
+	// the pots are moved in turn (reported as synth.c does), in steps that mostly only change fine CCs,
+	// nothing was sent for them before
+
+	for(i=0;i<MOVE_COUNT;++i)
+	{
+		for(j=0;j<POT_COUNT;++j)
+		{
+			currentPreset.continuousParameters[params[j]]=0x2000+j*0x8000+i*0x80;
+			midi_sendContinuousParameter(params[j],currentPreset.continuousParameters[params[j]],POT_BITS);
+			size+=collect(MS(20),&buf[size],sizeof(buf)-size);
+		}
+	}
+
+	size+=collect(MS(200),&buf[size],sizeof(buf)-size);
+
+	for(j=0;j<POT_COUNT;++j)
+		sent[j]=currentPreset.continuousParameters[params[j]]&0xfffc;
+
+	// the same stream into a P600 in preset mode, starting from where the receiver was
+
+	settings.presetMode=1;
+	for(j=0;j<POT_COUNT;++j)
+		currentPreset.continuousParameters[params[j]]=0;
+
+	host_midiIn(buf,size);
+	host_run(size*HOST_MIDI_BYTE_CYCLES+MS(20));
+
+	for(j=0;j<POT_COUNT;++j)
+		CHECK((currentPreset.continuousParameters[params[j]]&0xfffc)==sent[j]);
+
+	printf("panelloop_test: %d moves of %d pots in %u bytes, looped back the same\n",MOVE_COUNT,(int)POT_COUNT,size);
+
+	return 0;
+}
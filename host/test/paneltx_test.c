@@ -0,0 +1,164 @@
+////////////////////////////////////////////////////////////////////////////////
+// Checks panel moves sent to MIDI: thinning, byte budget, notes go first
+////////////////////////////////////////////////////////////////////////////////
+
+#include "test.h"
+#include "../p600host.h"
+#include "storage.h"
+#include "midi.h"
+
+#define MS(ms) ((uint64_t)(ms)*(HOST_CPU_HZ/1000))
+
+#define SWEEP_MS 1000
+#define PANEL_QUEUE_LIMIT 32 // see midi.c
+#define PANEL_BYTES_PER_TICK 1
+#define PANEL_BURST_BYTES 24
+
+static uint8_t status,data[2],dataCount;
+static uint8_t selected=0xff,msb;
+static uint16_t lastValue[cpCount];
+static uint32_t dataEntries,noteMessages,panelBytes;
+
+// running status parser, across calls
+static void parse(const uint8_t * buf, uint32_t size)
+{
+	uint32_t i;
+
+	for(i=0;i<size;++i)
+	{
+		if(buf[i]&0x80)
+		{
+			status=buf[i];
+			dataCount=0;
+			if(status==0xb0)
+				++panelBytes;
+			continue;
+		}
+
+		data[dataCount++]=buf[i];
+		if(dataCount<2)
+			continue;
+		dataCount=0;
+
+		if((status&0xe0)==0x80) // note on/off
+		{
+			++noteMessages;
+			continue;
+		}
+
+		CHECK(status==0xb0);
+		panelBytes+=2;
+
+		switch(data[0])
+		{
+		case 99:
+			CHECK(data[1]==0);
+			break;
+		case 98:
+			selected=data[1];
+			break;
+		case 6:
+			msb=data[1];
+			break;
+		case 38:
+			CHECK(selected<cpCount);
+			lastValue[selected]=(msb<<9)|(data[1]<<2);
+			++dataEntries;
+			break;
+		case 1: // mod wheel & sustain, at boot
+		case 64:
+			break;
+		default:
+			CHECK(0);
+		}
+	}
+}
+
+// the host event log only holds a few ms, read it as we go
+// (from the previous read, bytes sent between two runs are logged in the past)
+static void run(uint64_t cycles)
+{
+	static uint8_t buf[1024];
+	static uint64_t start=0;
+	uint64_t end=host.cycle+cycles;
+
+	while(host.cycle<end)
+	{
+		host_run(MIN(MS(1),end-host.cycle));
+		parse(buf,host_getMidiOut(buf,sizeof(buf),start));
+		start=host.cycle;
+	}
+}
+
+int main(void)
+{
+	uint32_t i,entries,ticks;
+	uint16_t overflows;
+	uint8_t highWater;
+
+	host_init(NULL);
+	host_boot();
+	run(MS(100));
+	status=0xb0; // boot sends controllers already, running status might be on
+
+	// 1 bit cutoff steps, only every other one is sent
+
+	host_setPot(ppCutoff,0x8000);
+	run(MS(20));
+
+	entries=dataEntries;
+	for(i=1;i<=32;++i)
+	{
+		host_setPot(ppCutoff,0x8000+i*0x10);
+		run(MS(20));
+	}
+
+	entries=dataEntries-entries;
+	CHECK_RANGE(entries,15,17);
+	CHECK(lastValue[cpCutoff]>>5==currentPreset.continuousParameters[cpCutoff]>>5);
+
+	// three pots swept as fast as possible, with notes
+
+	midi_resetSendStats();
+	ticks=currentTick;
+	panelBytes=0;
+	noteMessages=0;
+
+	for(i=0;i<SWEEP_MS;++i)
+	{
+		host_setPot(ppCutoff,(i&1)?0x1000+i*32:0xf000-i*32);
+		host_setPot(ppResonance,(i*0x1234)&0xffff);
+		host_setPot(ppFreqA,i*64);
+
+		if(i%10==0)
+			midi_sendNoteEvent(60+i%12,1,HALF_RANGE);
+		else if(i%10==5)
+			midi_sendNoteEvent(60+(i-5)%12,0,HALF_RANGE);
+
+		run(MS(1));
+	}
+
+	midi_getSendStats(&highWater,&overflows);
+	ticks=currentTick-ticks;
+
+	printf("paneltx_test: sweep %u panel bytes/s, %u data entries, queue high water %u\n",
+			panelBytes*1000/SWEEP_MS,dataEntries-entries,highWater);
+
+	// the budget holds, notes are never held back
+
+	CHECK(panelBytes<=ticks*PANEL_BYTES_PER_TICK+PANEL_BURST_BYTES);
+	CHECK(panelBytes>=ticks*PANEL_BYTES_PER_TICK/2);
+	CHECK(noteMessages==SWEEP_MS/5);
+	CHECK(overflows==0);
+	CHECK(highWater<=PANEL_QUEUE_LIMIT+8);
+
+	// once still, the latest values are sent
+
+	run(MS(100));
+
+	CHECK(lastValue[cpCutoff]==(currentPreset.continuousParameters[cpCutoff]&0xfffc));
+	CHECK(lastValue[cpResonance]==(currentPreset.continuousParameters[cpResonance]&0xfffc));
+	CHECK(lastValue[cpFreqA]==(currentPreset.continuousParameters[cpFreqA]&0xfffc));
+
+	return 0;
+}
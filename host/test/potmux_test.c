@@ -0,0 +1,89 @@
+////////////////////////////////////////////////////////////////////////////////
+// Checks the adaptive pot scheduler: fast while moving, slow when still, budgeted
+////////////////////////////////////////////////////////////////////////////////
+
+#include "test.h"
+#include "../p600host.h"
+#include "potmux.h"
+
+#define MS(ms) ((uint64_t)(ms)*(HOST_CPU_HZ/1000))
+
+static uint16_t absDiff(uint16_t a, uint16_t b)
+{
+	return a>b?a-b:b-a;
+}
+
+int main(void)
+{
+	uint32_t conversions,rounds;
+	uint8_t peak;
+	uint16_t lag,maxLag=0;
+	int32_t i;
+
+	host_init(NULL);
+	host_boot();
+
+	// still pots settle on their idle interval
+
+	host_run(MS(1000));
+	CHECK(potmux_getScanInterval(ppCutoff)>1);
+	CHECK(potmux_getScanInterval(ppResonance)>1);
+	CHECK(potmux_getScanInterval(ppFreqA)>1);
+
+	potmux_resetStats();
+	host_run(MS(200));
+	potmux_getStats(&conversions,&rounds,&peak);
+	CHECK(conversions>0);
+	CHECK(peak<=POTMUX_STEP_BUDGET);
+
+	// still pots are verified with a tracking conversion instead of a full one
+
+	CHECK(rounds<conversions*7);
+	fprintf(stderr,"potmux_test: idle %u conversions, %.1f rounds per conversion, peak %u rounds per update\n",
+			conversions,(double)rounds/conversions,peak);
+
+	// cutoff & resonance sweeps are scanned on each update and tracked closely
+
+	potmux_resetStats();
+	for(i=1;i<=200;++i)
+	{
+		host_setPot(ppCutoff,0xf000-i*300);
+		host_setPot(ppResonance,i*300);
+		host_run(MS(2));
+
+		CHECK(potmux_getScanInterval(ppCutoff)==1);
+		if(i>1) // the first 1 LSB step of resonance from rest looks like jitter
+			CHECK(potmux_getScanInterval(ppResonance)==1);
+
+		lag=absDiff(potmux_getValue(ppCutoff),host.pots[ppCutoff]);
+		maxLag=MAX(maxLag,lag);
+	}
+
+	potmux_getStats(&conversions,&rounds,&peak);
+	CHECK(peak<=POTMUX_STEP_BUDGET);
+	CHECK(maxLag<=0x200);
+	fprintf(stderr,"potmux_test: sweep max cutoff lag %u, peak %u rounds per update\n",maxLag,peak);
+
+	// once still again, they decay back to a slow refresh
+
+	host_run(MS(2000));
+	CHECK(potmux_getScanInterval(ppResonance)>1);
+
+	// an 8 bit pot flickering by 1 LSB isn't moving (once another pot was touched, see potExcited)
+
+	host_setPot(ppAmpAtt,0x8000);
+	host_run(MS(100));
+	host_setPot(ppResonance,0x2000);
+	host_run(MS(100));
+
+	for(i=0;i<500;++i)
+	{
+		host_setPot(ppAmpAtt,0x8000+(i&1)*0x100);
+		host_run(MS(4));
+	}
+
+	CHECK(potmux_getScanInterval(ppAmpAtt)>=64); // its idle interval is 70
+	fprintf(stderr,"potmux_test: 8 bit pot with 1 LSB of jitter scanned every %u updates\n",potmux_getScanInterval(ppAmpAtt));
+
+	return 0;
+}
@@ -0,0 +1,159 @@
+////////////////////////////////////////////////////////////////////////////////
+// Checks presets from 100 on can be reached: number pad in the hundred of the
+// current preset, data dial, program changes in bank 2, two byte dump requests
+////////////////////////////////////////////////////////////////////////////////
+
+#include "test.h"
+#include "../p600host.h"
+#include "storage.h"
+#include "ui.h"
+#include "display.h"
+#include "map_to_7segment.h"
+
+#define MS(ms) ((uint64_t)(ms)*(HOST_CPU_HZ/1000))
+
+static SEG7_DEFAULT_MAP(seg7);
+
+static uint16_t mark(uint16_t number)
+{
+	return 0x100*(number+1);
+}
+
+static void save(uint16_t number)
+{
+	currentPreset.continuousParameters[cpCutoff]=mark(number);
+	CHECK(preset_saveCurrent(number));
+}
+
+// the host event log only holds a few ms, MIDI out is read as we go
+static uint8_t out[8192];
+static uint32_t outSize;
+static uint64_t collected;
+
+static void run(uint64_t cycles)
+{
+	uint64_t end=host.cycle+cycles;
+
+	while(host.cycle<end)
+	{
+		host_run(MIN(MS(5),end-host.cycle));
+		outSize+=host_getMidiOut(&out[outSize],sizeof(out)-outSize,collected);
+		collected=host.cycle;
+	}
+}
+
+static void press(p600Button_t button)
+{
+	host_setButton(button,1);
+	run(MS(30));
+	host_setButton(button,0);
+	run(MS(30));
+}
+
+static int8_t shows(char left, char right)
+{
+	return (host.displayRows[1]&0x7f)==map_to_seg7(&seg7,left) && (host.displayRows[2]&0x7f)==map_to_seg7(&seg7,right);
+}
+
+static void midiIn(const uint8_t * data, uint32_t size)
+{
+	host_midiIn(data,size);
+	run(size*HOST_MIDI_BYTE_CYCLES+HOST_STORAGE_READ_CYCLES+MS(100)); // the display is refreshed from the main loop
+}
+
+// the last bank select & program change sent from an offset in the MIDI out on
+static void lastProgram(uint32_t from, int16_t * bank, int16_t * program)
+{
+	uint32_t i;
+
+	*bank=*program=-1;
+	for(i=from;i+1<outSize;++i)
+	{
+		if(out[i]==0xb0 && out[i+1]==0 && i+2<outSize)
+			*bank=out[i+2];
+		else if(out[i]==0xc0)
+			*program=out[i+1];
+	}
+}
+
+int main(void)
+{
+	static const uint8_t bank1Program5[]={0xb0,0,1,0xc0,5};
+	static const uint8_t bank2Program50[]={0xb0,0,2,0xc0,50};
+	static const uint8_t bank2Program120[]={0xc0,120};
+	static const uint8_t request150[]={0xf0,SYSEX_ID_0,SYSEX_ID_1,SYSEX_ID_2,SYSEX_COMMAND_PATCH_DUMP_REQUEST,150&0x7f,150>>7,0xf7};
+	uint32_t from,i;
+	int16_t bank,program;
+
+	host_init(NULL);
+	host_boot();
+	settings.presetMode=1;
+	host_run(MS(100));
+	sevenSeg_scrollText(NULL,0); // the boot message
+	collected=host.cycle;
+
+	save(5);
+	save(170);
+	CHECK(preset_loadCurrent(5,0));
+	settings.presetNumber=5;
+
+	// the data dial goes up to 199, a program change past 127 is in bank 2
+
+	ui.digitInput=diLoadDecadeDigit;
+	from=outSize;
+
+	host_setButton(pbFromTape,1);
+	run(MS(30));
+	host_setPot(ppSpeed,(uint32_t)(2*170+1)*0x10000/(2*PRESET_COUNT));
+	run(MS(200));
+	host_setButton(pbFromTape,0);
+	run(MS(100));
+
+	CHECK(settings.presetNumber==170);
+	CHECK(currentPreset.continuousParameters[cpCutoff]==mark(170));
+	CHECK(shows('h','0'));
+
+	lastProgram(from,&bank,&program);
+	CHECK(bank==2 && program==70);
+
+	// two digits store & load in the hundred of the current preset
+
+	currentPreset.continuousParameters[cpCutoff]=mark(150);
+	press(pbRecord);
+	press(pb5);
+	CHECK(shows('F',' '));
+	press(pb0);
+
+	CHECK(preset_checkPage(150));
+	CHECK(settings.presetNumber==150);
+	CHECK(shows('F','0'));
+
+	// program changes: bank 1 as before, bank 2 from 100 on, empty presets are ignored
+
+	midiIn(bank1Program5,sizeof(bank1Program5));
+	CHECK(settings.presetNumber==5);
+	CHECK(currentPreset.continuousParameters[cpCutoff]==mark(5));
+	CHECK(shows('0','5'));
+
+	midiIn(bank2Program50,sizeof(bank2Program50));
+	CHECK(settings.presetNumber==150);
+	CHECK(currentPreset.continuousParameters[cpCutoff]==mark(150));
+
+	midiIn(bank2Program120,sizeof(bank2Program120));
+	CHECK(settings.presetNumber==150);
+
+	// a dump request with the high bits of the number in a second byte
+
+	from=outSize;
+	midiIn(request150,sizeof(request150));
+	run(MS(500));
+
+	for(i=from;i<outSize && out[i]!=0xf0;++i);
+	CHECK(i+10<outSize);
+	CHECK(out[i+4]==SYSEX_COMMAND_PATCH_DUMP);
+	CHECK((out[i+5]|((out[i+9]&1)<<7))==150);
+
+	printf("presetbank_test: presets up to %d reached from the panel, MIDI programs & dump requests\n",PRESET_COUNT-1);
+
+	return 0;
+}
@@ -0,0 +1,131 @@
+////////////////////////////////////////////////////////////////////////////////
+// Checks the preset directory: presets are listed without reading their page,
+// it follows saves & imports, it's rebuilt when missing
+////////////////////////////////////////////////////////////////////////////////
+
+#include "test.h"
+#include "../p600host.h"
+#include "storage.h"
+#include "midi.h"
+#include "ui.h"
+
+#define MS(ms) ((uint64_t)(ms)*(HOST_CPU_HZ/1000))
+
+#define DIRECTORY_PAGE ((STORAGE_SIZE/STORAGE_PAGE_SIZE)-2) // see storage.c
+#define SLOT_COUNT 100
+
+static uint8_t listPresets(uint8_t * versions, uint8_t * hashes)
+{
+	uint8_t i,count=0;
+
+	for(i=0;i<SLOT_COUNT;++i)
+	{
+		versions[i]=hashes[i]=0;
+
+		if(preset_checkPage(i))
+		{
+			CHECK(preset_getDirectoryEntry(i,&versions[i],&hashes[i]));
+			++count;
+		}
+		else
+		{
+			CHECK(!preset_getDirectoryEntry(i,&versions[i],&hashes[i]));
+		}
+	}
+
+	return count;
+}
+
+int main(void)
+{
+	static uint8_t buf[STORAGE_PAGE_SIZE+1],out[4096],zeroes[STORAGE_PAGE_SIZE];
+	static uint8_t versions[SLOT_COUNT],hashes[SLOT_COUNT],rebuiltVersions[SLOT_COUNT],rebuiltHashes[SLOT_COUNT];
+	uint32_t reads,listReads,dumpReads,rebuildReads,size=0,dumps=0,i;
+	uint64_t chunk,start;
+	int16_t exportedSize;
+
+	host_init(NULL);
+	host_boot();
+	host_run(MS(100));
+
+	// on an empty storage, the directory says so
+
+	CHECK(listPresets(versions,hashes)==0);
+
+	// saves & imports are in it
+
+	preset_saveCurrent(3);
+	memcpy(currentPreset.patchName,"Brass           ",16);
+	preset_saveCurrent(7);
+
+	storage_export(3,buf,&exportedSize);
+	ui.isInPatchManagement=1;
+	storage_import(9,&buf[1],exportedSize-1);
+	ui.isInPatchManagement=0;
+
+	storage_flush();
+
+	// listing takes no page read besides the directory one
+
+	host.storageLatency=1;
+	reads=host.storageReads;
+
+	CHECK(listPresets(versions,hashes)==3);
+	CHECK(preset_checkPage(3) && preset_checkPage(7) && preset_checkPage(9));
+	CHECK(versions[3]==9 && versions[7]==9 && versions[9]==9);
+	CHECK(hashes[3]==hashes[9]);
+	CHECK(hashes[3]!=hashes[7]);
+
+	listReads=host.storageReads-reads;
+	CHECK(listReads<=1);
+
+	// a bank dump only reads the presets that are there
+
+	reads=host.storageReads;
+	midi_dumpPresets();
+
+	start=host.cycle;
+	while(host.cycle<start+MS(1500))
+	{
+		chunk=host.cycle;
+		host_run(MS(5));
+		size+=host_getMidiOut(&out[size],sizeof(out)-size,chunk);
+	}
+
+	for(i=0;i<size;++i)
+		if(out[i]==0xf0)
+			++dumps;
+
+	dumpReads=host.storageReads-reads;
+	CHECK(dumps==3);
+	CHECK(dumpReads<=3);
+
+	// lost directory, it's rebuilt from the preset pages, the same
+
+	host.storageLatency=0;
+	CHECK(preset_loadCurrent(3,0)); // the cache doesn't hold the directory page anymore
+	CHECK(preset_loadCurrent(7,0));
+	storage_write(DIRECTORY_PAGE,zeroes);
+
+	reads=host.storageReads;
+	preset_loadDirectory();
+	rebuildReads=host.storageReads-reads;
+
+	CHECK(rebuildReads>SLOT_COUNT);
+	CHECK(listPresets(rebuiltVersions,rebuiltHashes)==3);
+	CHECK(!memcmp(versions,rebuiltVersions,sizeof(versions)));
+	CHECK(!memcmp(hashes,rebuiltHashes,sizeof(hashes)));
+
+	// and written back
+
+	storage_flush();
+	reads=host.storageReads;
+	preset_loadDirectory();
+	CHECK(host.storageReads-reads<=1);
+	CHECK(preset_checkPage(7));
+
+	printf("presetdir_test: %u presets listed in %u page reads, bank dump in %u page reads, rebuild in %u page reads\n",
+			SLOT_COUNT,listReads,dumpReads,rebuildReads);
+
+	return 0;
+}
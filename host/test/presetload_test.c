@@ -0,0 +1,156 @@
+////////////////////////////////////////////////////////////////////////////////
+// Checks asynchronous preset loads: ticks go on during the EEPROM read,
+// the preset is swapped in at once, MIDI changes after a program change stay,
+// notes & keys don't wait for the read
+////////////////////////////////////////////////////////////////////////////////
+
+#include "test.h"
+#include "../p600host.h"
+#include "storage.h"
+
+#define MS(ms) ((uint64_t)(ms)*(HOST_CPU_HZ/1000))
+
+#define MIDI_BASE_COARSE_CC 16
+
+static void save(uint16_t number)
+{
+	currentPreset.continuousParameters[cpCutoff]=0x1000*(number+1);
+	currentPreset.continuousParameters[cpResonance]=0x800*(number+1);
+	currentPreset.steppedParameters[spBSaw]=number&1;
+	preset_saveCurrent(number);
+}
+
+// when a voice was first heard
+static uint64_t firstAmpOpen(uint64_t from)
+{
+	uint32_t i;
+	struct hostEvent_s * e;
+
+	for(i=(host.logCount>HOST_LOG_SIZE)?host.logCount-HOST_LOG_SIZE:0;i<host.logCount;++i)
+	{
+		e=&host.log[i%HOST_LOG_SIZE];
+		if(e->cycle>=from && e->type==hevCV && e->index>=pcAmp1 && e->index<pcAmp1+SYNTH_VOICE_COUNT && e->value>0)
+			return e->cycle;
+	}
+
+	return UINT64_MAX;
+}
+
+int main(void)
+{
+	const uint8_t during[]={0xc0,1,0x90,60,100,0xc0,2};
+	const uint8_t noteOff[]={0x80,60,0};
+	uint8_t msg[5];
+	uint32_t missed,syncMissed,asyncMissed,ticks;
+	uint64_t start;
+	uint16_t i;
+
+	host_init(NULL);
+	host_boot();
+	settings.presetMode=1; // pots don't change the preset under us
+	host_run(MS(100));
+
+	for(i=1;i<=6;++i)
+		save(i);
+
+	storage_flush();
+	host.storageLatency=1;
+
+	// what it used to cost: interrupts are off for the whole read
+
+	missed=host.missedTicks;
+	CHECK(preset_loadCurrent(1,0));
+	host_run(MS(5));
+	syncMissed=host.missedTicks-missed;
+	CHECK(currentPreset.continuousParameters[cpCutoff]==0x2000);
+
+	// asynchronous: pending until the main loop read it, then swapped in on a tick
+
+	missed=host.missedTicks;
+	ticks=host.ticks;
+	start=host.cycle;
+
+	preset_loadLater(2);
+	CHECK(preset_getPendingLoad()==2);
+	CHECK(currentPreset.continuousParameters[cpCutoff]==0x2000);
+
+	host_run(HOST_STORAGE_READ_CYCLES+MS(5));
+
+	asyncMissed=host.missedTicks-missed;
+	CHECK(preset_getPendingLoad()<0);
+	CHECK(settings.presetNumber==2);
+	CHECK(currentPreset.continuousParameters[cpCutoff]==0x3000);
+	CHECK(currentPreset.continuousParameters[cpResonance]==0x1800);
+	CHECK(asyncMissed==0);
+	CHECK(host.ticks-ticks>=(host.cycle-start)/HOST_TIMER_CYCLES-1);
+
+	// a program change is applied the same way, a CC right after it isn't lost
+
+	msg[0]=0xc0;
+	msg[1]=3;
+	msg[2]=0xb0;
+	msg[3]=MIDI_BASE_COARSE_CC+cpCutoff;
+	msg[4]=0x20;
+	host_midiIn(msg,sizeof(msg));
+	host_run(sizeof(msg)*HOST_MIDI_BYTE_CYCLES+HOST_STORAGE_READ_CYCLES+MS(10));
+
+	CHECK(settings.presetNumber==3);
+	CHECK((currentPreset.continuousParameters[cpCutoff]>>9)==0x20);
+	CHECK(currentPreset.continuousParameters[cpResonance]==0x2000);
+	CHECK(currentPreset.steppedParameters[spBSaw]==1);
+	CHECK(host.gates&(1<<pgBSaw));
+
+	// the latest request wins, empty pages are ignored
+
+	msg[1]=4;
+	host_midiIn(msg,2);
+	msg[1]=5;
+	host_midiIn(msg,2);
+	host_run(4*HOST_MIDI_BYTE_CYCLES+2*HOST_STORAGE_READ_CYCLES+MS(10));
+
+	CHECK(settings.presetNumber==5);
+	CHECK(currentPreset.continuousParameters[cpCutoff]==0x6000);
+
+	msg[1]=50;
+	host_midiIn(msg,2);
+	host_run(2*HOST_MIDI_BYTE_CYCLES+HOST_STORAGE_READ_CYCLES+MS(10));
+
+	CHECK(preset_getPendingLoad()<0);
+	CHECK(settings.presetNumber==5);
+	CHECK(currentPreset.continuousParameters[cpCutoff]==0x6000);
+	CHECK(currentPreset.steppedParameters[spBSaw]==1);
+
+	// notes, keys & program changes don't wait for a read: the note plays during it, the latest program is read after it
+
+	start=host.cycle;
+	host_midiIn(during,sizeof(during));
+	host_run(sizeof(during)*HOST_MIDI_BYTE_CYCLES+2*HOST_STORAGE_READ_CYCLES+MS(10));
+
+	CHECK(firstAmpOpen(start)-start<HOST_STORAGE_READ_CYCLES);
+	CHECK(settings.presetNumber==2);
+	CHECK(currentPreset.continuousParameters[cpCutoff]==0x3000);
+
+	host_midiIn(noteOff,sizeof(noteOff));
+	host_run(MS(20));
+
+	start=host.cycle;
+	msg[1]=3; // not cached
+	host_midiIn(msg,2);
+	host_setKey(60,1); // echoed to MIDI out
+	host_run(2*HOST_MIDI_BYTE_CYCLES+HOST_STORAGE_READ_CYCLES+MS(10));
+	host_setKey(60,0);
+
+	CHECK(host_findEvent(hevMidiOut,-1,start)-start<HOST_STORAGE_READ_CYCLES);
+	CHECK(settings.presetNumber==3);
+
+	// a synchronous load comes after a pending one
+
+	preset_loadLater(6);
+	CHECK(preset_loadCurrent(4,0));
+	host_run(HOST_STORAGE_READ_CYCLES+MS(5));
+	CHECK(currentPreset.continuousParameters[cpCutoff]==0x5000);
+
+	printf("presetload_test: ticks missed while loading a preset, %u before, %u now\n",syncMissed,asyncMissed);
+
+	return 0;
+}
@@ -0,0 +1,210 @@
+////////////////////////////////////////////////////////////////////////////////
+// Checks the v9 bit packed presets: round trip, two per page, older single
+// preset pages still read and left as they are until they're saved again
+////////////////////////////////////////////////////////////////////////////////
+
+#include "test.h"
+#include "../p600host.h"
+#include "storage.h"
+
+#define MS(ms) ((uint64_t)(ms)*(HOST_CPU_HZ/1000))
+
+#define STORAGE_MAGIC 0x006116a5 // see storage.c
+#define SINGLE_PRESET 8
+#define QUANTIZATION_ERROR 0x180 // at 8 bits, the lowest width: half a step, a step more at the top for full scale
+
+static uint8_t * put16(uint8_t * p, uint16_t v)
+{
+	*p++=v;
+	*p++=v>>8;
+	return p;
+}
+
+// a page as version 8 wrote it (see syxmgmt/storage_8.spec)
+static void writeV8Page(uint16_t pageIdx, const struct preset_s * pr)
+{
+	static uint8_t page[STORAGE_PAGE_SIZE];
+	uint8_t * p=page;
+	int i;
+
+	memset(page,0,sizeof(page));
+
+	p=put16(p,STORAGE_MAGIC&0xffff);
+	p=put16(p,STORAGE_MAGIC>>16);
+	*p++=8;
+
+	for(i=cpFreqA;i<=cpFilVelocity;++i)
+		p=put16(p,pr->continuousParameters[i]);
+	for(i=spASaw;i<=spChromaticPitch;++i)
+		*p++=(i==holdPedal)?pr->steppedParameters[spAmpEnvSlow]:pr->steppedParameters[i];
+	for(i=cpModDelay;i<cpSeqArpClock;++i)
+		p=put16(p,pr->continuousParameters[i]);
+	p=put16(p,0);
+	for(i=spModwheelTarget;i<=spVibTarget;++i)
+		*p++=pr->steppedParameters[i];
+	for(i=0;i<SYNTH_VOICE_COUNT;++i)
+		*p++=pr->voicePattern[i];
+	for(i=0;i<TUNER_NOTE_COUNT;++i)
+		p=put16(p,pr->perNoteTuning[i]);
+
+	*p++=pr->steppedParameters[spPWMBug];
+	p=put16(p,pr->continuousParameters[cpSpread]);
+	p=put16(p,pr->continuousParameters[cpExternal]);
+	*p++=pr->steppedParameters[spEnvRouting];
+	*p++=pr->steppedParameters[spAssign];
+	*p++=pr->steppedParameters[spLFOSync];
+	memcpy(p,pr->patchName,16);
+
+	storage_write(pageIdx,page);
+}
+
+static void checkPreset(const struct preset_s * a, const struct preset_s * b, int8_t exact)
+{
+	int i,d;
+
+	for(i=0;i<cpCount;++i)
+	{
+		if(i==cpSeqArpClock || i>=cpMixVolA)
+			continue;
+
+		d=(int)a->continuousParameters[i]-(int)b->continuousParameters[i];
+		CHECK_RANGE(d,exact?0:-QUANTIZATION_ERROR,exact?0:QUANTIZATION_ERROR);
+	}
+
+	for(i=0;i<spCount;++i)
+		if(i!=10) // unused slot
+			CHECK(a->steppedParameters[i]==b->steppedParameters[i]);
+
+	CHECK(!memcmp(a->voicePattern,b->voicePattern,sizeof(a->voicePattern)));
+	CHECK(!memcmp(a->perNoteTuning,b->perNoteTuning,sizeof(a->perNoteTuning)));
+	CHECK(!memcmp(a->patchName,b->patchName,sizeof(a->patchName)));
+}
+
+int main(void)
+{
+	static struct preset_s single,saved;
+	static uint8_t buf[STORAGE_PAGE_SIZE+1];
+	uint32_t i,writes;
+	int16_t size,packedSize,singleSize;
+	uint8_t version,hash;
+
+	host_init(NULL);
+
+	// an older single preset page, there before the first boot
+
+	memset(&single,0,sizeof(single));
+	for(i=0;i<cpCount;++i)
+		single.continuousParameters[i]=0x1234*(i+1);
+	single.steppedParameters[spASaw]=1;
+	single.steppedParameters[spLFOShape]=5;
+	single.steppedParameters[spBenderSemitones]=12;
+	single.steppedParameters[spAmpEnvSlow]=1;
+	single.steppedParameters[holdPedal]=1;
+	single.steppedParameters[spLFOSync]=6;
+	memset(single.voicePattern,ASSIGNER_NO_NOTE,sizeof(single.voicePattern));
+	single.voicePattern[0]=0;
+	single.voicePattern[1]=7;
+	for(i=0;i<TUNER_NOTE_COUNT;++i)
+		single.perNoteTuning[i]=i*TUNING_UNITS_PER_SEMITONE+i;
+	memcpy(single.patchName,"Old Strings     ",16);
+
+	writeV8Page(SINGLE_PRESET,&single);
+
+	host_boot();
+	host_run(MS(100));
+
+	// it's read as it was, the other half of its page is no preset
+
+	CHECK(preset_getDirectoryEntry(SINGLE_PRESET,&version,&hash));
+	CHECK(version==8);
+	CHECK(!preset_checkPage(SINGLE_PRESET+PRESET_PAGE_COUNT));
+
+	CHECK(preset_loadCurrent(SINGLE_PRESET,0));
+	checkPreset(&single,&currentPreset,1);
+	CHECK(!preset_loadCurrent(SINGLE_PRESET+PRESET_PAGE_COUNT,0));
+
+	storage_export(SINGLE_PRESET,buf,&singleSize);
+	CHECK(singleSize-1>STORAGE_PAGE_SIZE/2);
+
+	// round trip, two presets in a page
+
+	memcpy(&saved,&currentPreset,sizeof(saved));
+	saved.continuousParameters[cpCutoff]=UINT16_MAX;
+	saved.continuousParameters[cpFreqBFine]=HALF_RANGE;
+	saved.continuousParameters[cpResonance]=0x1234;
+	saved.steppedParameters[spTrackingShift]=2;
+	saved.steppedParameters[spLFOTargets]=mtVCO|mtOnlyB;
+	memcpy(saved.patchName,"New Brass       ",16);
+	memcpy(&currentPreset,&saved,sizeof(saved));
+
+	storage_flush();
+	writes=host.storageWrites;
+
+	preset_saveCurrent(5);
+	preset_saveCurrent(5+PRESET_PAGE_COUNT);
+	storage_flush();
+
+	CHECK(preset_checkPage(5) && preset_checkPage(5+PRESET_PAGE_COUNT));
+	CHECK(host.storageWrites-writes==3); // the page & a directory page for each
+
+	CHECK(preset_loadCurrent(5+PRESET_PAGE_COUNT,0));
+	checkPreset(&saved,&currentPreset,0);
+	CHECK(currentPreset.continuousParameters[cpCutoff]==UINT16_MAX);
+	CHECK(currentPreset.continuousParameters[cpFreqBFine]==HALF_RANGE);
+
+	CHECK(preset_loadCurrent(5,0));
+	checkPreset(&saved,&currentPreset,0);
+
+	// quantized values don't move anymore once saved again
+
+	preset_saveCurrent(5);
+	storage_flush();
+	memcpy(&saved,&currentPreset,sizeof(saved));
+	CHECK(preset_loadCurrent(5,0));
+	checkPreset(&saved,&currentPreset,1);
+
+	// the largest packed preset fits half a page
+
+	memset(&currentPreset,0xff,sizeof(currentPreset));
+	preset_saveCurrent(6);
+	storage_export(6,buf,&size);
+	packedSize=size-1;
+	CHECK(packedSize<=STORAGE_PAGE_SIZE/PRESETS_PER_PAGE);
+
+	// the single preset page isn't shared, its preset would be quantized
+
+	memcpy(&currentPreset,&saved,sizeof(saved));
+	storage_flush();
+	writes=host.storageWrites;
+
+	CHECK(!preset_saveCurrent(SINGLE_PRESET+PRESET_PAGE_COUNT));
+	storage_flush();
+
+	CHECK(host.storageWrites==writes);
+	CHECK(!preset_checkPage(SINGLE_PRESET+PRESET_PAGE_COUNT));
+	CHECK(preset_getDirectoryEntry(SINGLE_PRESET,&version,&hash));
+	CHECK(version==8);
+	CHECK(preset_loadCurrent(SINGLE_PRESET,0));
+	checkPreset(&single,&currentPreset,1);
+
+	// once saved again, as the user chose to, it stays within quantization and there is room for another
+
+	CHECK(preset_saveCurrent(SINGLE_PRESET));
+	memcpy(&currentPreset,&saved,sizeof(saved));
+	CHECK(preset_saveCurrent(SINGLE_PRESET+PRESET_PAGE_COUNT));
+
+	CHECK(preset_getDirectoryEntry(SINGLE_PRESET,&version,&hash));
+	CHECK(version==9);
+	CHECK(preset_loadCurrent(SINGLE_PRESET,0));
+	checkPreset(&single,&currentPreset,0);
+	CHECK(preset_loadCurrent(SINGLE_PRESET+PRESET_PAGE_COUNT,0));
+	checkPreset(&saved,&currentPreset,1);
+
+	storage_export(SINGLE_PRESET,buf,&size);
+	CHECK(size-1<=STORAGE_PAGE_SIZE/PRESETS_PER_PAGE);
+
+	printf("presetpack_test: %d bytes per preset at most instead of %d, %d presets in %d pages\n",
+			packedSize,singleSize-1,PRESET_COUNT,PRESET_PAGE_COUNT);
+
+	return 0;
+}
@@ -0,0 +1,117 @@
+////////////////////////////////////////////////////////////////////////////////
+// Checks the timer interrupt cycle accounting and its sysex readout
+////////////////////////////////////////////////////////////////////////////////
+
+#include "test.h"
+#include "../p600host.h"
+#include "profiler.h"
+
+#define MS(ms) ((uint64_t)(ms)*(HOST_CPU_HZ/1000))
+
+static const char * sectionNames[prsCount]={"lfo","voices","bitinputs","midi","clock","vibrato","scanner","total"};
+
+static uint16_t read16(const uint8_t * p)
+{
+	return p[0]|(p[1]<<8);
+}
+
+// undoes the 4+1 scrambling of sysexSend()
+static int16_t descramble(const uint8_t * in, int16_t size, uint8_t * out)
+{
+	int16_t i,j,n=0;
+
+	for(i=0;i+5<=size;i+=5)
+		for(j=0;j<4;++j)
+			out[n++]=in[i+j]|(((in[i+4]>>j)&1)<<7);
+
+	return n;
+}
+
+int main(void)
+{
+	const uint8_t request[]={0xf0,SYSEX_ID_0,SYSEX_ID_1,SYSEX_ID_2,SYSEX_COMMAND_PROFILER_REQUEST,1,0xf7};
+	const uint8_t noteOn[]={0x90,60,100,0x90,64,100,0x90,67,100};
+	const struct profilerStats_s * s;
+	uint8_t reply[256],dump[256];
+	uint32_t size;
+	uint16_t sum;
+	uint64_t start;
+	int8_t i;
+
+	host_init(NULL);
+	host_boot();
+
+	host_midiIn(noteOn,sizeof(noteOn));
+	profiler_reset();
+	host_run(MS(200));
+
+	// every section ran, and the stats are consistent
+
+	sum=0;
+	for(i=0;i<prsCount;++i)
+	{
+		s=profiler_getStats(i);
+		CHECK(s->count>0);
+		CHECK(s->min<=profiler_getAverage(i));
+		CHECK(profiler_getAverage(i)<=s->max);
+		printf("%-10s min %4u avg %4u max %4u\n",sectionNames[i],s->min,profiler_getAverage(i),s->max);
+		if(i<prsTotal)
+			sum+=profiler_getAverage(i);
+	}
+
+	CHECK_RANGE(profiler_getStats(prsTotal)->count,395,405);
+	CHECK(profiler_getStats(prsVoices)->max>0);
+	CHECK(profiler_getAverage(prsTotal)>=profiler_getAverage(prsVoices));
+
+	// phases run every 4th tick only, so the total is below the sum of the averages
+
+	CHECK(profiler_getAverage(prsTotal)<=sum);
+
+	// sysex readout, with reset
+
+	start=host.cycle;
+	host_midiIn(request,sizeof(request));
+	host_run(MS(100));
+
+	size=host_getMidiOut(reply,sizeof(reply),start);
+	CHECK(size>6);
+	CHECK(reply[0]==0xf0);
+	CHECK(reply[1]==SYSEX_ID_0 && reply[2]==SYSEX_ID_1 && reply[3]==SYSEX_ID_2);
+	CHECK(reply[4]==SYSEX_COMMAND_PROFILER_DUMP);
+	CHECK(reply[size-1]==0xf7);
+
+	CHECK(descramble(&reply[5],size-6,dump)>=6+prsCount*6+40);
+	CHECK(dump[0]==5);
+	CHECK(dump[1]==prsCount);
+	CHECK(read16(&dump[2])==CYCLE_COUNT_PER_TICK);
+	CHECK(read16(&dump[6+prsTotal*6+4])>0);
+
+	// S&H writes and skipped writes follow the sections
+
+	CHECK(read16(&dump[6+prsCount*6])>0 || read16(&dump[6+prsCount*6+2])>0);
+	CHECK(read16(&dump[6+prsCount*6+4])>0 || read16(&dump[6+prsCount*6+6])>0);
+
+	// then pot conversions and their DAC/comparator rounds
+
+	CHECK(read16(&dump[6+prsCount*6+8])>0 || read16(&dump[6+prsCount*6+10])>0);
+	CHECK(read16(&dump[6+prsCount*6+12])>0 || read16(&dump[6+prsCount*6+14])>0);
+
+	// then MIDI send queue high water and overflows, the dump is the first output since boot
+
+	CHECK(read16(&dump[6+prsCount*6+16])<=128);
+	CHECK(read16(&dump[6+prsCount*6+18])==0);
+
+	// then storage cache hits, misses, pages written & committed, and the write queue:
+	// the first boot saved default settings, notes are held, so they still wait
+
+	CHECK(read16(&dump[6+prsCount*6+36])<=2);
+	CHECK(read16(&dump[6+prsCount*6+36])==0 || read16(&dump[6+prsCount*6+38])>0);
+
+	// stats were reset after the dump, only ticks since then are counted
+
+	CHECK(profiler_getStats(prsTotal)->count<250);
+
+	printf("profiler_test: %u overruns\n",profiler_getOverruns());
+
+	return 0;
+}
@@ -0,0 +1,168 @@
+////////////////////////////////////////////////////////////////////////////////
+// Checks the MIDI out running status on an arp & pitch bend stream, or that
+// every message has its status when it's off (the default, see synth.h)
+// Built both ways, runningstatus_on_test has MIDI_RUNNING_STATUS (see Makefile)
+////////////////////////////////////////////////////////////////////////////////
+
+#include "test.h"
+#include "../p600host.h"
+#include "midi.h"
+#include "storage.h"
+
+#define MS(ms) ((uint64_t)(ms)*(HOST_CPU_HZ/1000))
+
+struct message_s
+{
+	uint8_t status,d1,d2;
+};
+
+// arp output with a hand on the bender, as sent by the firmware
+static struct message_s expected[1024];
+static int16_t expectedCount;
+
+static void noteEvent(uint8_t note, int8_t gate)
+{
+	midi_sendNoteEvent(note,gate,HALF_RANGE);
+#ifdef MIDI_RUNNING_STATUS
+	// note off are note on with velocity 0
+	expected[expectedCount++]=(struct message_s){0x90|settings.midiSendChannel,note,gate?64:0};
+#else
+	expected[expectedCount++]=(struct message_s){(gate?0x90:0x80)|settings.midiSendChannel,note,64};
+#endif
+}
+
+static void bendEvent(int16_t bend)
+{
+	uint16_t v=(uint16_t)(bend-INT16_MIN)>>2;
+
+	midi_sendWheelEvent(bend,0,1);
+	expected[expectedCount++]=(struct message_s){0xe0|settings.midiSendChannel,v&0x7f,v>>7};
+}
+
+// running status aware parser, returns message count
+static int16_t parse(const uint8_t * buf, uint32_t size, struct message_s * out)
+{
+	uint8_t status=0,data[2];
+	int8_t n=0;
+	int16_t count=0;
+	uint32_t i;
+
+	for(i=0;i<size;++i)
+	{
+		if(buf[i]&0x80)
+		{
+			status=buf[i];
+			n=0;
+			continue;
+		}
+
+		CHECK(status!=0);
+		data[n++]=buf[i];
+		if(n==2)
+		{
+			out[count++]=(struct message_s){status,data[0],data[1]};
+			n=0;
+		}
+	}
+
+	return count;
+}
+
+// the host event log only holds a few ms, read it as we go
+static uint32_t collect(uint64_t start, uint64_t cycles, uint8_t * buf, uint32_t maxSize)
+{
+	uint64_t end=host.cycle+cycles;
+	uint32_t size=0;
+
+	while(host.cycle<end)
+	{
+		host_run(MIN(MS(5),end-host.cycle));
+		size+=host_getMidiOut(&buf[size],maxSize-size,start);
+		start=host.cycle;
+	}
+
+	return size;
+}
+
+int main(void)
+{
+	static uint8_t buf[4096];
+	static struct message_s parsed[1024];
+	uint64_t start;
+	uint32_t size;
+	int16_t i,j,count;
+
+	host_init(NULL);
+	host_boot();
+	host_run(MS(100));
+
+	// dense stream, at about the wire rate
+
+	size=0;
+	for(i=0;i<32;++i)
+	{
+		start=host.cycle;
+		noteEvent(48+(i%12),1);
+		for(j=0;j<4;++j)
+			bendEvent((i*4+j+1)*64);
+		noteEvent(48+(i%12),0);
+		size+=collect(start,MS(5),&buf[size],sizeof(buf)-size);
+	}
+
+	size+=collect(host.cycle,MS(50),&buf[size],sizeof(buf)-size);
+	count=parse(buf,size,parsed);
+
+	CHECK(count==expectedCount);
+	for(i=0;i<count;++i)
+	{
+		CHECK(parsed[i].status==expected[i].status);
+		CHECK(parsed[i].d1==expected[i].d1);
+		CHECK(parsed[i].d2==expected[i].d2);
+	}
+
+#ifdef MIDI_RUNNING_STATUS
+	// each note on/off pair costs one status, and so does the bend run in between
+
+	CHECK(size<=(uint32_t)expectedCount*2+32*3);
+#else
+	CHECK(size==(uint32_t)expectedCount*3);
+#endif
+	printf("runningstatus_%s: %d messages in %u bytes instead of %d (%.1f%% saved)\n",
+#ifdef MIDI_RUNNING_STATUS
+			"on_test",
+#else
+			"test",
+#endif
+			count,size,expectedCount*3,100.0-100.0*size/(expectedCount*3));
+
+	// the status is resent after a while, even when it didn't change (always when running status is off)
+
+	noteEvent(60,1);
+	host_run(MS(600));
+	start=host.cycle;
+	noteEvent(60,0);
+	host_run(MS(10));
+
+	size=host_getMidiOut(buf,sizeof(buf),start);
+	CHECK(size==3);
+	CHECK(buf[0]==expected[expectedCount-1].status);
+
+	// but not before RUNNING_STATUS_REFRESH_TICKS (500ms)
+
+	noteEvent(62,1);
+	host_run(MS(400));
+	start=host.cycle;
+	noteEvent(62,0);
+	host_run(MS(10));
+
+	size=host_getMidiOut(buf,sizeof(buf),start);
+#ifdef MIDI_RUNNING_STATUS
+	CHECK(size==2);
+	CHECK(buf[0]==62 && buf[1]==0);
+#else
+	CHECK(size==3);
+	CHECK(buf[0]==expected[expectedCount-1].status);
+#endif
+
+	return 0;
+}
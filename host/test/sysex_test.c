@@ -0,0 +1,131 @@
+////////////////////////////////////////////////////////////////////////////////
+// Checks the streaming sysex decoder: patch dump round trip, rejected messages
+////////////////////////////////////////////////////////////////////////////////
+
+#include "test.h"
+#include "../p600host.h"
+#include "storage.h"
+#include "ui.h"
+#include "midi.h"
+
+#define MS(ms) ((uint64_t)(ms)*(HOST_CPU_HZ/1000))
+
+// the host event log only holds a few ms, read it as we go
+static uint32_t collect(uint64_t start, uint64_t cycles, uint8_t * buf, uint32_t maxSize)
+{
+	uint64_t end=host.cycle+cycles;
+	uint32_t size=0;
+
+	while(host.cycle<end)
+	{
+		host_run(MIN(MS(5),end-host.cycle));
+		size+=host_getMidiOut(&buf[size],maxSize-size,start);
+		start=host.cycle;
+	}
+
+	return size;
+}
+
+static void checkSamePreset(uint16_t a, uint16_t b)
+{
+	static uint8_t bufA[TEMP_BUFFER_SIZE],bufB[TEMP_BUFFER_SIZE];
+	int16_t sizeA,sizeB;
+
+	storage_export(a,bufA,&sizeA);
+	storage_export(b,bufB,&sizeB);
+
+	CHECK(sizeA==sizeB);
+	CHECK(!memcmp(&bufA[1],&bufB[1],sizeA-1));
+}
+
+int main(void)
+{
+	const uint8_t noteOn[]={0x90,60,100};
+	const uint8_t request[]={0xf0,SYSEX_ID_0,SYSEX_ID_1,SYSEX_ID_2,SYSEX_COMMAND_PATCH_DUMP_REQUEST,5,0xf7};
+	static uint8_t dump[1024],foreign[2000],reply[1024];
+	uint32_t dumpSize,size,i;
+	uint64_t start;
+
+	host_init(NULL);
+	host_boot();
+	host_run(MS(100));
+
+	ui.isInPatchManagement=1;
+	preset_saveCurrent(5);
+	CHECK(preset_checkPage(5));
+	CHECK(!preset_checkPage(7));
+
+	// get a patch dump
+
+	start=host.cycle;
+	midi_dumpPreset(5); // blocks until the end of the dump is queued
+	dumpSize=collect(start,MS(200),dump,sizeof(dump));
+	CHECK(dumpSize>STORAGE_PAGE_SIZE/4); // a packed preset, half a page at most
+	CHECK(dump[0]==0xf0 && dump[4]==SYSEX_COMMAND_PATCH_DUMP && dump[dumpSize-1]==0xf7);
+	CHECK(dump[5]==5);
+
+	// foreign messages are dropped as they come, whatever their size
+
+	memset(tempBuffer,0x55,TEMP_BUFFER_SIZE);
+
+	foreign[0]=0xf0;
+	foreign[1]=0x41;
+	for(i=2;i<sizeof(foreign)-1;++i)
+		foreign[i]=i&0x7f;
+	foreign[sizeof(foreign)-1]=0xf7;
+
+	host_midiIn(foreign,sizeof(foreign));
+	host_run(MS(800));
+	CHECK(tempBuffer[1]==0x55);
+	CHECK(tempBuffer[TEMP_BUFFER_SIZE-1]==0x55);
+
+	// a dump that doesn't fit a page is rejected, so is one cut by another message
+
+	memcpy(foreign,dump,dumpSize-1);
+	foreign[5]=8;
+	for(i=dumpSize-1;i<dumpSize-1+STORAGE_PAGE_SIZE*5/4;++i)
+		foreign[i]=0x11;
+	foreign[i++]=0xf7;
+
+	host_midiIn(foreign,i);
+	host_run(MS(400));
+	CHECK(!preset_checkPage(8));
+
+	foreign[5]=9;
+	host_midiIn(foreign,dumpSize/2);
+	host_midiIn(noteOn,sizeof(noteOn));
+	host_run(MS(200));
+	CHECK(!preset_checkPage(9));
+
+	// the dump is decoded back into another patch, the storage used meanwhile by the main loop doesn't mix in it
+
+	memcpy(currentPreset.patchName,"Strings         ",16);
+	currentPreset.continuousParameters[cpCutoff]=0x1234;
+	preset_saveCurrent(6);
+
+	dump[5]=7;
+	host_midiIn(dump,dumpSize/2);
+	host_run(MS(100));
+	preset_loadLater(6);
+	host_run(MS(100));
+	CHECK(preset_getPendingLoad()<0);
+	host_midiIn(&dump[dumpSize/2],dumpSize-dumpSize/2);
+	host_run(MS(200));
+
+	CHECK(preset_checkPage(7));
+	checkSamePreset(5,7);
+
+	// requests still work after all that
+
+	ui.isInPatchManagement=0;
+	dump[5]=5;
+
+	host_midiIn(request,sizeof(request));
+	size=collect(host.cycle,MS(200),reply,sizeof(reply));
+	CHECK(size==dumpSize);
+	CHECK(!memcmp(reply,dump,dumpSize));
+
+	printf("sysex_test: %u bytes patch dump round trip ok\n",dumpSize);
+
+	return 0;
+}
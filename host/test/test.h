@@ -0,0 +1,20 @@
+#ifndef TEST_H
+#define	TEST_H
+
+#include <stdio.h>
+#include <stdlib.h>
+
+// minimal checks for the host tests, a failed check ends the test program
+
+#define CHECK(cond) \
+	do{ \
+		if(!(cond)) \
+		{ \
+			fprintf(stderr,"%s:%d: check failed: %s\n",__FILE__,__LINE__,#cond); \
+			exit(1); \
+		} \
+	}while(0)
+
+#define CHECK_RANGE(v,lo,hi) CHECK((v)>=(lo) && (v)<=(hi))
+
+#endif	/* TEST_H */
@@ -0,0 +1,75 @@
+////////////////////////////////////////////////////////////////////////////////
+// Checks the note to CV conversion against the reference formula
+////////////////////////////////////////////////////////////////////////////////
+
+#include "test.h"
+#include "../p600host.h"
+#include "tuner.h"
+#include "storage.h"
+
+static uint16_t reference(uint8_t note, uint8_t nextInterp, p600CV_t cv)
+{
+	uint8_t oct=note/12;
+	uint32_t lo,hi,noteTuning;
+
+	lo=(oct<TUNER_OCTAVE_COUNT)?settings.tunes[oct][cv]:MIN(settings.tunes[TUNER_OCTAVE_COUNT-1][cv]+(uint32_t)(oct-TUNER_OCTAVE_COUNT+1)*(uint16_t)(settings.tunes[TUNER_OCTAVE_COUNT-1][cv]-settings.tunes[TUNER_OCTAVE_COUNT-2][cv]),UINT16_MAX);
+	++oct;
+	hi=(oct<TUNER_OCTAVE_COUNT)?settings.tunes[oct][cv]:MIN(settings.tunes[TUNER_OCTAVE_COUNT-1][cv]+(uint32_t)(oct-TUNER_OCTAVE_COUNT+1)*(uint16_t)(settings.tunes[TUNER_OCTAVE_COUNT-1][cv]-settings.tunes[TUNER_OCTAVE_COUNT-2][cv]),UINT16_MAX);
+
+	noteTuning=currentPreset.perNoteTuning[note%12];
+	noteTuning+=((uint32_t)nextInterp<<8)/12;
+
+	return lo+((noteTuning*(uint16_t)(hi-lo))>>16);
+}
+
+static void checkAll(void)
+{
+	int16_t note,interp;
+	p600CV_t cv;
+
+	for(cv=pcOsc1A;cv<=pcFil6;++cv)
+		for(note=0;note<=UINT8_MAX;++note)
+			for(interp=0;interp<=UINT8_MAX;++interp)
+				CHECK(tuner_computeCVFromNote(note,interp,cv)==reference(note,interp,cv));
+}
+
+int main(void)
+{
+	const uint8_t noteOn[]={0x90,60,100};
+	uint16_t before;
+	int8_t i;
+
+	host_init(NULL);
+	host_boot();
+
+	checkAll();
+
+	// per note tuning (MTS), up to a whole octave so that it carries with the interpolation
+
+	before=tuner_computeCVFromNote(61,0,pcOsc1A);
+	tuner_setNoteTuning(1,1.5);
+	CHECK(tuner_computeCVFromNote(61,0,pcOsc1A)>before);
+	tuner_setNoteTuning(11,11.9);
+	checkAll();
+
+	// a new tuning
+
+	for(i=0;i<TUNER_OCTAVE_COUNT;++i)
+		settings.tunes[i][pcOsc2B]+=100;
+	checkAll();
+
+	// a preset load
+
+	preset_loadDefault(1);
+	checkAll();
+
+	// the synth still plays
+
+	host_midiIn(noteOn,sizeof(noteOn));
+	host_run(HOST_CPU_HZ/20);
+	CHECK(assigner_getAnyAssigned());
+
+	printf("tuner_test: ok\n");
+
+	return 0;
+}
@@ -0,0 +1,167 @@
+////////////////////////////////////////////////////////////////////////////////
+// Checks the EEPROM write queue: bursts of saves are collapsed, committed later
+// in the background and in order, explicit stores right away
+////////////////////////////////////////////////////////////////////////////////
+
+#include "test.h"
+#include "../p600host.h"
+#include "storage.h"
+
+#define MS(ms) ((uint64_t)(ms)*(HOST_CPU_HZ/1000))
+
+#define BANK_SELECT_COUNT 50
+#define SETTINGS_PAGE ((STORAGE_SIZE/STORAGE_PAGE_SIZE)-4) // 2 pages, see storage.c
+#define COMMIT_DEBOUNCE_MS 500
+#define COMMIT_MAX_DELAY_MS 5000
+#define COMMIT_INTERVAL_MS 150
+
+static void bankSelect(uint8_t bank)
+{
+	uint8_t msg[3]={0xb0,0,bank};
+
+	host_midiIn(msg,sizeof(msg));
+	host_run(3*HOST_MIDI_BYTE_CYCLES+MS(3));
+}
+
+// when a voice that was silent is first heard
+static uint64_t firstVoiceOpen(uint64_t from, uint8_t open)
+{
+	uint32_t i;
+	struct hostEvent_s * e;
+
+	for(i=(host.logCount>HOST_LOG_SIZE)?host.logCount-HOST_LOG_SIZE:0;i<host.logCount;++i)
+	{
+		e=&host.log[i%HOST_LOG_SIZE];
+		if(e->cycle>=from && e->type==hevCV && e->index>=pcAmp1 && e->index<pcAmp1+SYNTH_VOICE_COUNT &&
+				!(open&(1<<(e->index-pcAmp1))) && e->value>0)
+			return e->cycle;
+	}
+
+	return UINT64_MAX;
+}
+
+int main(void)
+{
+	uint32_t i,writes,missed,queued;
+	uint16_t oldest;
+	uint8_t pending,open;
+	const uint8_t noteOn[]={0xb0,3,0,0xb0,3,0,0xb0,3,0,0xb0,3,0,0x90,64,100};
+	uint64_t start;
+
+	host_init(NULL);
+	host_boot();
+	host_run(MS(100));
+
+	// presets saved once, the directory doesn't change afterwards
+
+	for(i=10;i<=13;++i)
+		preset_saveCurrent(i);
+
+	storage_flush();
+
+	host.storageLatency=1;
+
+	// a burst of bank selects, each of them saves the settings
+
+	writes=host.storageWrites;
+	storage_resetCacheStats();
+
+	for(i=0;i<BANK_SELECT_COUNT;++i)
+		bankSelect(i&1);
+
+	storage_getWriteQueue(&pending,&oldest,&queued);
+
+	// (the 2nd settings page doesn't change)
+
+	CHECK_RANGE(queued,BANK_SELECT_COUNT,BANK_SELECT_COUNT*2);
+	CHECK_RANGE(pending,1,2);
+	CHECK(host.storageWrites==writes);
+
+	// once left alone, only the last settings are committed, interrupts go on meanwhile
+
+	missed=host.missedTicks;
+	host_run(MS(COMMIT_DEBOUNCE_MS+500));
+
+	storage_getWriteQueue(&pending,&oldest,&queued);
+
+	CHECK(pending==0);
+	CHECK_RANGE(host.storageWrites-writes,1,2);
+	CHECK(settings_load());
+	CHECK(settings.presetMode==((BANK_SELECT_COUNT-1)&1));
+
+	printf("writequeue_test: %u bank selects, %u page writes, %u ticks missed while committing\n",
+			BANK_SELECT_COUNT,host.storageWrites-writes,host.missedTicks-missed);
+
+	CHECK(host.missedTicks==missed);
+
+	// while a key is down, settings wait, but not forever
+
+	host_setKey(60,1);
+	host_run(MS(20));
+
+	writes=host.storageWrites;
+	bankSelect(0);
+	host_run(MS(COMMIT_DEBOUNCE_MS+500));
+	CHECK(host.storageWrites==writes);
+
+	start=host.cycle;
+	while(host.storageWrites==writes && host.cycle<start+MS(COMMIT_MAX_DELAY_MS))
+		host_run(MS(10));
+
+	CHECK(host.storageWrites==writes+1);
+	CHECK_RANGE(host.lastStorageWrite,SETTINGS_PAGE,SETTINGS_PAGE+1);
+
+	// an explicit store doesn't, the settings queued before it go first, in order
+
+	writes=host.storageWrites;
+	bankSelect(1);
+	currentPreset.continuousParameters[cpCutoff]+=0x100;
+	preset_saveCurrent(10);
+
+	start=host.cycle;
+	while(host.lastStorageWrite!=10 && host.cycle<start+MS(COMMIT_DEBOUNCE_MS*2))
+		host_run(MS(10));
+
+	CHECK(host.lastStorageWrite==10);
+	CHECK_RANGE(host.storageWrites-writes,2,3); // 1 or 2 settings pages, then the preset
+	CHECK(host.cycle-start>=(host.storageWrites-writes-1)*MS(COMMIT_INTERVAL_MS));
+
+	// notes aren't held while a page is written, one that comes during the write plays right away
+
+	host_run(MS(COMMIT_INTERVAL_MS*2));
+
+	writes=host.storageWrites;
+	open=0;
+	for(i=0;i<SYNTH_VOICE_COUNT;++i)
+		if(host.cvs[pcAmp1+i])
+			open|=1<<i;
+
+	currentPreset.continuousParameters[cpCutoff]+=0x100;
+	preset_saveCurrent(10);
+	start=host.cycle;
+	host_midiIn(noteOn,sizeof(noteOn)); // a couple of CCs then the note
+	host_run(MS(100));
+
+	CHECK(host.storageWrites==writes+1);
+	CHECK(firstVoiceOpen(start,open)-start<sizeof(noteOn)*HOST_MIDI_BYTE_CYCLES+MS(5));
+
+	host_setKey(60,0);
+
+	// a full queue makes room with its oldest page first
+
+	writes=host.storageWrites;
+	currentPreset.continuousParameters[cpCutoff]+=0x100;
+	preset_saveCurrent(11);
+	preset_saveCurrent(12);
+	CHECK(host.storageWrites==writes);
+
+	preset_saveCurrent(13);
+	CHECK(host.storageWrites==writes+1);
+	CHECK(host.lastStorageWrite==11);
+
+	storage_flush();
+	CHECK(host.storageWrites==writes+3);
+	CHECK(host.lastStorageWrite==13);
+
+	return 0;
+}
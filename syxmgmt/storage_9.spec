@@ -0,0 +1,62 @@
+Frequency A;1;12
+Volume A;1;8
+PWA;1;10
+Frequency B;1;12
+Volume B;1;8
+PWB;1;10
+Frequency Fine B;1;12
+Cutoff;1;12
+Resonance;1;8
+Filter Envelope Amount;1;10
+Filter Release;1;8
+Filter Sustain;1;10
+Filter Decay;1;8
+Filter Attack;1;8
+2nd Release;1;8
+2nd Sustain;1;10
+2nd Decay;1;8
+2nd Attack;1;8
+Poly Mod Envelope Amount;1;10
+Poly Mod OSC B;1;10
+LFO Frequency;1;10
+LFO Amount;1;12
+Glide;1;8
+Amp Velocity;1;12
+Filter Velocity;1;12
+Modulation Delay;1;12
+Vibrato Frequency;1;12
+Vibrato Amount;1;12
+Unison Detune;1;12
+Ext Voltage;1;12
+Vintage;1;12
+Saw A;1;1
+Tri A;1;1
+SQR A;1;1
+Saw B;1;1
+Tri B;1;1
+SQR B;1;1
+Sync;1;1
+Poly Mod Frequency A;1;1
+Poly Mod Filter;1;1
+LFO Shape;1;3
+LFO Targets;1;6
+Tracking Shift;1;2
+Filter Envelope Shape;1;1
+Filter Envelope Speed;1;1
+Amp Envelope Shape;1;1
+Unison;1;1
+Assigner Priority;1;2
+Bender Semitones;1;4
+Bender Target;1;3
+Modulation Wheel Range;1;2
+Chromatic Pitch;1;3
+Modulation Wheel Target;1;1
+Vibrato Target;1;2
+Amp Envelope Speed;1;1
+PW Bug;1;1
+Voice Assigner;1;1
+Envelope Routing;1;2
+LFO Sync;1;4
+Voice Pattern (6 voices);6;8
+Tuning per Note (12 notes);12;16
+Patch Name;16;8
@@ -25,6 +25,7 @@ options, args = parser.parse_args()
 data = []
 spec7 = []
 spec8 = []
+spec9 = []
 
 fittingSpec = []
 
@@ -38,6 +39,11 @@ for c in fileVar.readlines():
 	spec8.append([c.split(';')[0],int(c.split(';')[1]),int(c.split(';')[2])])
 fileVar.close()
 
+fileVar = open("storage_9.spec","rt")
+for c in fileVar.readlines():
+	spec9.append([c.split(';')[0],int(c.split(';')[1]),int(c.split(';')[2])])
+fileVar.close()
+
 fileVar = open(args[0],"rb")
 f = fileVar.read(1)
 
@@ -134,10 +140,30 @@ for patch in patches:
     elif patch[5]==8:
         fittingSpec=spec8
         print('Storage version is 8')
+    elif patch[5]==9:
+        fittingSpec=spec9
+        print('Storage version is 9 (bit packed)')
     else:
         print('Unsupported storage version: ', patch[5])
         quit()
 
+    if patch[5]>=9: # the spec tells the width in bits, LSB first
+        bitPos=0
+        for spec in fittingSpec:
+            for cnt in range(0,spec[1]):
+                value=0
+                for b in range(0,spec[2]):
+                    byte=6+(bitPos>>3)
+                    if byte<=len(patch)-1: # assume zero
+                        value|=((patch[byte]>>(bitPos&7))&1)<<b
+                    bitPos+=1
+
+                if spec[1]>1:
+                    print(spec[0], '(', cnt+1, ' of ', spec[1],'): ', value)
+                else:
+                    print(spec[0], ': ', value)
+        continue
+
     i=6
     msb=0
     lsb=0
@@ -0,0 +1,83 @@
+//this is a single reader, single writer byte queue that doesn't need to block interrupts
+//based on bytequeue, Copyright 2008 Alex Norman
+//
+//This file is part of avr-bytequeue.
+//
+//avr-bytequeue is free software: you can redistribute it and/or modify
+//it under the terms of the GNU General Public License as published by
+//the Free Software Foundation, either version 3 of the License, or
+//(at your option) any later version.
+//
+//avr-bytequeue is distributed in the hope that it will be useful,
+//but WITHOUT ANY WARRANTY; without even the implied warranty of
+//MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//GNU General Public License for more details.
+//
+//You should have received a copy of the GNU General Public License
+//along with avr-bytequeue.  If not, see <http://www.gnu.org/licenses/>.
+
+#include "spscqueue.h"
+
+//keeps the compiler from moving data accesses across index updates
+#define SPSCQUEUE_BARRIER() __asm__ __volatile__("" ::: "memory")
+
+#ifdef SPSCQUEUE_16BIT_INDEX
+
+#include "interrupt_setting.h"
+
+static spscQueueIndex_t load_index(volatile spscQueueIndex_t * index){
+   spscQueueIndex_t value;
+   interrupt_setting_t setting = store_and_clear_interrupt();
+   value = *index;
+   restore_interrupt_setting(setting);
+   return value;
+}
+
+static void store_index(volatile spscQueueIndex_t * index, spscQueueIndex_t value){
+   interrupt_setting_t setting = store_and_clear_interrupt();
+   *index = value;
+   restore_interrupt_setting(setting);
+}
+
+#else
+
+#define load_index(index) (*(index))
+#define store_index(index, value) (*(index) = (value))
+
+#endif
+
+bool spscqueue_init(spscQueue_t * queue, uint8_t * dataArray, uint16_t arrayLen){
+   if(arrayLen < 2 || (arrayLen & (arrayLen - 1)) || (spscQueueIndex_t)(arrayLen - 1) != arrayLen - 1)
+      return false;
+   queue->mask = arrayLen - 1;
+   queue->data = dataArray;
+   queue->start = queue->end = 0;
+   return true;
+}
+
+bool spscqueue_enqueue(spscQueue_t * queue, uint8_t item){
+   spscQueueIndex_t end = queue->end;
+   spscQueueIndex_t next = (end + 1) & queue->mask;
+   //full
+   if(next == load_index(&queue->start))
+      return false;
+   queue->data[end] = item;
+   SPSCQUEUE_BARRIER();
+   store_index(&queue->end, next);
+   return true;
+}
+
+spscQueueIndex_t spscqueue_length(spscQueue_t * queue){
+   return (load_index(&queue->end) - load_index(&queue->start)) & queue->mask;
+}
+
+uint8_t spscqueue_get(spscQueue_t * queue, spscQueueIndex_t index){
+   SPSCQUEUE_BARRIER();
+   return queue->data[(queue->start + index) & queue->mask];
+}
+
+void spscqueue_remove(spscQueue_t * queue, spscQueueIndex_t numToRemove){
+   SPSCQUEUE_BARRIER();
+   store_index(&queue->start, (queue->start + numToRemove) & queue->mask);
+}
+
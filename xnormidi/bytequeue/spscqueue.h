@@ -0,0 +1,70 @@
+//this is a single reader, single writer byte queue that doesn't need to block interrupts
+//based on bytequeue, Copyright 2008 Alex Norman
+//
+//This file is part of avr-bytequeue.
+//
+//avr-bytequeue is free software: you can redistribute it and/or modify
+//it under the terms of the GNU General Public License as published by
+//the Free Software Foundation, either version 3 of the License, or
+//(at your option) any later version.
+//
+//avr-bytequeue is distributed in the hope that it will be useful,
+//but WITHOUT ANY WARRANTY; without even the implied warranty of
+//MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//GNU General Public License for more details.
+//
+//You should have received a copy of the GNU General Public License
+//along with avr-bytequeue.  If not, see <http://www.gnu.org/licenses/>.
+
+#ifndef SPSCQUEUE_H
+#define SPSCQUEUE_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif 
+
+#include <inttypes.h>
+#include <stdbool.h>
+
+//the writer only moves end, the reader only moves start, so each can be
+//interrupted by the other without any locking.
+//sizes must be a power of 2, the queue holds up to size - 1 bytes.
+//8 bit indices allow sizes up to 256, define SPSCQUEUE_16BIT_INDEX for more
+//(AVR can't load or store those atomically, so interrupts are then blocked
+//around the index accesses only)
+
+#ifdef SPSCQUEUE_16BIT_INDEX
+typedef uint16_t spscQueueIndex_t;
+#else
+typedef uint8_t spscQueueIndex_t;
+#endif
+
+typedef struct {
+	volatile spscQueueIndex_t start;
+	volatile spscQueueIndex_t end;
+	spscQueueIndex_t mask;
+	uint8_t * data;
+} spscQueue_t;
+
+//you must have a queue, an array of data which the queue will use, and the length of that array
+//returns false if the length isn't a power of 2 that the index can address
+bool spscqueue_init(spscQueue_t * queue, uint8_t * dataArray, uint16_t arrayLen);
+
+//writer: add an item to the queue, returns false if the queue is full
+bool spscqueue_enqueue(spscQueue_t * queue, uint8_t item);
+
+//either side: get the length of the queue
+spscQueueIndex_t spscqueue_length(spscQueue_t * queue);
+
+//reader: this grabs data at the index given [starting at queue->start]
+uint8_t spscqueue_get(spscQueue_t * queue, spscQueueIndex_t index);
+
+//reader: update the index in the queue to reflect data that has been dealt with 
+void spscqueue_remove(spscQueue_t * queue, spscQueueIndex_t numToRemove);
+
+#ifdef __cplusplus
+}
+#endif 
+
+#endif
+
@@ -30,7 +30,7 @@ void midi_process_byte(MidiDevice * device, uint8_t input);
 void midi_device_init(MidiDevice * device){
    device->input_state = IDLE;
    device->input_count = 0;
-   bytequeue_init(&device->input_queue, device->input_queue_data, MIDI_INPUT_QUEUE_LENGTH);
+   spscqueue_init(&device->input_queue, device->input_queue_data, MIDI_INPUT_QUEUE_LENGTH);
 
    //three byte funcs
    device->input_cc_callback = NULL;
@@ -61,7 +61,7 @@ void midi_device_init(MidiDevice * device){
 void midi_device_input(MidiDevice * device, uint8_t cnt, uint8_t * input) {
    uint8_t i;
    for (i = 0; i < cnt; i++)
-      bytequeue_enqueue(&device->input_queue, input[i]);
+      spscqueue_enqueue(&device->input_queue, input[i]);
 }
 
 void midi_device_set_send_func(MidiDevice * device, midi_var_byte_func_t send_func){
@@ -78,13 +78,13 @@ void midi_device_process(MidiDevice * device) {
       device->pre_input_process_callback(device);
 
    //pull stuff off the queue and process
-   byteQueueIndex_t len = bytequeue_length(&device->input_queue);
+   spscQueueIndex_t len = spscqueue_length(&device->input_queue);
    uint16_t i;
    //TODO limit number of bytes processed?
    for(i = 0; i < len; i++) {
-      uint8_t val = bytequeue_get(&device->input_queue, 0);
+      uint8_t val = spscqueue_get(&device->input_queue, 0);
       midi_process_byte(device, val);
-      bytequeue_remove(&device->input_queue, 1);
+      spscqueue_remove(&device->input_queue, 1);
    }
 }
 
@@ -48,8 +48,8 @@ extern "C" {
  */
 
 #include "midi_function_types.h"
-#include "bytequeue/bytequeue.h"
-#define MIDI_INPUT_QUEUE_LENGTH 192
+#include "bytequeue/spscqueue.h"
+#define MIDI_INPUT_QUEUE_LENGTH 256 //power of 2, the input is written from an interrupt
 
 typedef enum {
    IDLE, 
@@ -109,7 +109,7 @@ struct _midi_device {
 
    //for queueing data between the input and the processing functions
    uint8_t input_queue_data[MIDI_INPUT_QUEUE_LENGTH];
-   byteQueue_t input_queue;
+   spscQueue_t input_queue;
 };
 
 /**